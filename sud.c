@@ -7,10 +7,105 @@
  *
  * Compile:
  *    gcc -o sud sud.c -lpthread
+ *    USDT probes (provider "sudoku") are built in when <sys/sdt.h> is
+ *    available (systemtap-sdt-dev); -DSUD_NO_SDT leaves them out. E.g.
+ *    bpftrace -e 'usdt:./sud:sudoku:backtrack { @[arg0] = count(); }'
+ *    gcc -DSUD_HEAP_COUNT -o sud sud.c -lpthread wraps malloc, calloc,
+ *    realloc and the aligned allocators (glibc only) to count every
+ *    heap allocation of the process, see g_heap_allocs and -B
  *
  * Input:
  *     1. Elements of Sudoku puzzle matrix in string format with column traversal
-            2. Number of threads to used
+            2. Number of threads to used. Optional: without it, or with
+               "auto", a hardness model picks the workers of each solve
+               (from one per CPU) and their search
+ *
+ * Options:
+ *    -n box      Side of a box, 2 to 5: solve 4x4 up to 25x25 puzzles
+ *                (default 3, i.e. 9x9); argv then holds n*n cells
+ *    -T file     Record a timeline of the solver threads and write it to
+ *                file as Chrome trace-event JSON (chrome://tracing, Perfetto)
+ *    -L          Profile acquisitions, wait and hold times of lock, mutex
+ *                and is_fin per thread and print a summary to stderr
+ *    -M file     Write solve, status, latency, queue and utilization
+ *                metrics to file for a Prometheus textfile collector
+ *    -f file     Solve every puzzle of file (one per line, 0 or . for
+ *                empty cells) instead of reading the cells from argv
+ *    -V          With -f or -B, run propagation on 8 puzzles at a time
+ *                in SIMD lanes and backtrack only those it cannot finish
+ *    -C cap      Count solutions instead of solving, up to cap (at least
+ *                2). Sends "unique" and the solution, "multiple" and the
+ *                count (cap+ once the cap is hit) or "unsolvable"
+ *    -u          Uniqueness check, same as -C 2
+ *    -E file     Enumerate every solution of the argv puzzle into file
+ *                ("-" streams them to the server). Each solution is n*n
+ *                cells of digit - 1 in ceil(log2 n) bits, first cell in
+ *                the low bits of the first byte, padded to whole bytes
+ *    -K file     With -E, checkpoint the enumeration to file every
+ *                CHECKPOINT_SECONDS; a rerun resumes from it
+ *    -G count    Generate count puzzles with a unique solution and print
+ *                them to stdout, one per line; throughput goes to stderr
+ *    -g clues    With -G, remove clues only down to this many
+ *    -S sym      With -G, keep clues symmetric: none (default), mirror,
+ *                180 or 90 (rotations)
+ *    -D lo:hi    With -G, keep puzzles rated (see -R) lo to hi, e.g. 2:4
+ *    -R          With -f, rate each puzzle by the hardest human technique
+ *                it needs and print "score technique" lines to stdout
+ *    -H entries  Cache up to entries results (9x9 and 4x4) under the
+ *                canonical form of the puzzle, so relabeled, permuted or
+ *                transposed repeats are answered without a search.
+ *                Capped at 2^24 entries (3 GB)
+ *    -Z entries  Share a table of up to entries boards (Zobrist hashed)
+ *                that no solution extends between all searches, so a
+ *                worker skips a subtree another worker or an earlier
+ *                restart or solve refuted. Hits go to -B and -M output.
+ *                Capped at 2^29 entries (4 GB)
+ *    -s file     Keep results in file, a memory-mapped table of canonical
+ *                puzzle to packed solution (see -H) that later runs and
+ *                other processes reuse. One process at a time appends
+ *    -p list     Race a portfolio of searches: worker i runs strategy i
+ *                (cyclically) of the comma separated list, from scan
+ *                (default), mrv, mrv-rev (MRV with digits high to low),
+ *                restart (randomized MRV with Luby restarts),
+ *                scan-restart (scan from random cells and digits with
+ *                Luby restarts), dlx (Dancing Links), simd (lockstep
+ *                vector propagation) and sat (CDCL with clause
+ *                learning, for 16x16 and up), or all. Races, wins per
+ *                strategy and restarts go to -B and -M output
+ *    -A n[:k]    Search each puzzle serially on the calling thread for n
+ *                nodes (default 2000) before starting the workers; they
+ *                then split what is left into k subtrees each (default
+ *                16). -A 0 always starts the workers at once
+ *    -j          Backtrack chronologically in scan and scan-restart
+ *                instead of jumping back to the latest assignment that
+ *                ruled out a dead end's digits
+ *    -e level    Propagation of simd and -V beyond singles: 0 singles,
+ *                1 locked (adds pointing and claiming), 2 subsets (adds
+ *                naked and hidden pairs and triples), 3 fish (adds
+ *                X-Wing and Swordfish); default 1, the fastest on 9x9
+ *                and 16x16 corpora. With -B and -V or simd in -p, best
+ *                times the levels in turns over max(-r, 3) passes each,
+ *                clearing -Z and -H between passes, and benchmarks the
+ *                fastest. Not with -s, whose records would carry over
+ *    -l [addr:]port  Serve: read puzzles, one per line as in -f, from
+ *                TCP clients on port and reply with a result line each.
+ *                Identical puzzles queued or running at the same time
+ *                are solved once and the result is fanned out. Listens
+ *                on 127.0.0.1 unless an IPv4 addr is given (0.0.0.0 for
+ *                all interfaces): clients are not authenticated. Serves
+ *                SERVE_CLIENTS connections at once, lines up to
+ *                SERVE_LINE bytes
+ *    -B file     Benchmark the puzzles of file for -r passes (default 5),
+ *                after an unmeasured warm-up pass, and print throughput
+ *                and latency percentiles. Built with -DSUD_HEAP_COUNT,
+ *                exit status 3 if solving allocates after the warm-up
+ *    -w file     With -B, save the sample as a versioned JSON baseline
+ *    -P          Count cache references and misses (hardware counters)
+ *                over the run and print them to stderr
+ *    -c file     With -B, compare against a baseline using bootstrap
+ *                confidence intervals; exit status 2 if throughput or a
+ *                latency percentile is worse by more than -x percent
+ *                (default 5)
 
 
  * Output:
@@ -19,6 +114,7 @@
 
  */
 
+#define _GNU_SOURCE
 
 #include <unistd.h>
 #include <stdbool.h>
@@ -30,292 +126,6318 @@
 #include <string.h>
 #include <arpa/inet.h>
 #include <time.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+/* Static tracepoints: a single nop each until a tracer attaches */
+#if !defined(SUD_NO_SDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SUD_SDT 1
+#endif
+#endif
+#ifdef SUD_SDT
+#define PROBE2(name, a, b) DTRACE_PROBE2(sudoku, name, a, b)
+#define PROBE3(name, a, b, c) DTRACE_PROBE3(sudoku, name, a, b, c)
+#else
+#define PROBE2(name, a, b) do { } while (0)
+#define PROBE3(name, a, b, c) do { } while (0)
+#endif
 
 
-#define BOARDSIZE (81)
-#define GRIDSIZE (9)
-#define LENGTH (3)
+#define MAXBOX (5)           // largest box side, 25x25 puzzles
+#define MAXN (MAXBOX * MAXBOX)
+#define MAXCELLS (MAXN * MAXN)
+#define MAXPEERS (3 * (MAXN - 1) - 2 * (MAXBOX - 1)) // 20 for 9x9, 64 here
+#define KERNEL static inline __attribute__((always_inline))
 #define PORT (7120)
+#define CACHELINE (64)
+#define TRACE_RING (1 << 14) // events kept per thread, oldest overwritten
+#define HDR_SUB (16)         // histogram sub-buckets per power of two
+#define HDR_BUCKETS (61 * HDR_SUB) // covers every 64 bit value
+#define BASELINE_VERSION (1)  // format of benchmark baseline files
+#define BOOTSTRAP_ROUNDS (2000) // resamples per confidence interval
+#define ARENA_BLOCK (64 * 1024) // minimum size of an arena block
+#define WORKER_STACK (1024 * 1024) // stack of a solve worker, see g_worker_attr
+#define LANES (8)             // puzzles propagated together, see solveGroup
+#define FRONTIER_SPLIT (16)   // subtrees per worker, see frontierSplit
+#define ENUM_SPLIT (4096)     // subtrees of an enumeration, fixed for resume
+#define ENUM_BUFFER (64 * 1024) // packed output a worker holds back
+#define CHECKPOINT_SECONDS (10) // time between enumeration checkpoints
+#define CHECKPOINT_VERSION (1)  // format of enumeration checkpoints
+#define CACHE_CELLS (81)      // largest puzzle the result cache takes
+#define CACHE_SHARDS (64)     // independent parts of the result cache
+#define CACHE_PROBE (8)       // slots searched per lookup
+#define CACHE_MAX_SLOTS ((size_t)1 << 18) // per shard, 3 GB; -H is clamped
+#define CANON_BUDGET (500000) // rows tried before giving up on a form
+#define STORE_VERSION (1)     // layout of the solution store file
+#define STORE_HEADER (4096)   // bytes before the first store record
+#define STORE_SLOTS (1 << 20) // records of a new solution store
+#define STORE_PROBE (32)      // slots searched per store lookup
+#define STORE_PACKED ((CACHE_CELLS + 1) / 2) // bytes of a packed grid
+#define STORE_WAIT_MS (2000)  // a reader waits this long for a new header
+#define FLIGHT_BUCKETS (256)  // chains of the in-flight puzzle table
+#define SERVE_CLIENTS (64)    // connections served at once, more wait
+#define SERVE_LINE (4096)     // longest request line, with its newline
+#define GEN_ATTEMPTS (10000)  // grids tried for one generated puzzle
+#define PORTFOLIO_MAX (32)           // workers given their own -p strategy
+#define RESTART_UNIT (16384)  // MRV restart budget per Luby sequence unit
+#define SCAN_RESTART_UNIT (65536) // the same for scan-restart
+#define SAT_HDR (4)           // clause header: size, flags, two watch links
+#define SAT_NIL (UINT32_MAX)  // end of a watch chain; decision reason
+#define SAT_AMO (0x80000000u) // reason tag: a true literal of the group
+#define SAT_LEARNT (0x80000000u) // clause flags, the LBD below them
+#define SAT_DEAD (0x40000000u)
+#define SAT_LEARNT_WORDS (1 << 20) // arena words for learnt clauses
+#define SAT_LEARNT_FIRST (2000) // learnt clauses before the first reduction
+#define SAT_RESTART_UNIT (100)  // conflicts per Luby unit
+#define SAT_DECAY (0.95)      // VSIDS activity decay per conflict
+#define ADAPT_BUDGET (2000)   // serial nodes before a solve goes parallel
+#define ROUTE_WORKER_NODES (20000) // predicted nodes worth one more worker
+#define ROUTE_DLX_NODES (300) // predicted nodes above which DLX beats MRV
+#define DEAD_BUCKET (8)       // slots of g_dead per cache line
+#define DEAD_OPEN_BITS (10)   // low bits of a slot: empty cells of the board
+#define DEAD_MIN_OPEN (60)    // percent of empty cells a kept board has
+#define DEAD_MAX_BUCKETS ((size_t)1 << 26) // 4 GB, larger -Z is clamped
+#define PROP_LEVELS (4)       // propagation tiers, see g_prop_names
+#define PROP_SWEEP_ROUNDS (3) // fewest passes per level of -e best
 
 
 
 struct timespec g_start; // for measuring execution time
 struct timespec g_finish;
 double g_elapsed;
-bool g_finished = 0; // execution status of a thread
-char buff[256]; // solve puzzle to be sent to server
-int sockfd;   // file descritor for created socket
+char buff[4 * MAXCELLS + 64]; // solve puzzle to be sent to server
+int sockfd = -1;   // file descritor for created socket, -1 when benchmarking
 pthread_mutex_t mutex;  // prevents race conditions for signaling variable
 pthread_cond_t is_fin;  // signal for main thread to finish execution
 pthread_rwlockattr_t mylock_attr; // attribute for rwlock lock
-pthread_rwlock_t lock;  // rwlock for variable finished
+/* Attributes of the workers started for every solve. The default 8 MB
+   stacks overflow glibc's 40 MB cache of stacks beyond five workers, and
+   each worker then allocates its stack and thread-local block anew */
+pthread_attr_t g_worker_attr;
 
+/* Globals touched on every search node, each alone on its cache line so
+   that stores to the neighbouring globals above never invalidate them */
+struct
+{
+    bool finished __attribute__((aligned(CACHELINE))); // a thread finished
+    pthread_rwlock_t lock __attribute__((aligned(CACHELINE))); // guards finished
+    uint64_t found __attribute__((aligned(CACHELINE))); // solutions counted
+} g_hot;
 
+int g_status;  // outcome of the last solve, one of ST_*
+int g_solve_seq = 0; // number of solves started, identifies probe events
+int g_active;  // workers still searching, guarded by lock
+bool g_batch = 0; // several puzzles per run, results are newline terminated
+bool g_lockstep = 0; // batch puzzles are propagated LANES at a time first
+bool g_backjump = 1; // the scan kernel jumps back to a dead end's culprit
+int g_prop_level = 1; // highest tier of lockstepPropagate, see -e
+/* Tiers of lockstepPropagate: singles, then locked candidates (pointing
+   and claiming), naked and hidden pairs and triples, X-Wing and
+   Swordfish; each level adds one to those below it */
+const char *g_prop_names[PROP_LEVELS] = { "singles", "locked", "subsets",
+                                          "fish" };
+uint64_t g_count_cap = 0; // count solutions up to this many, 0 = solve
+const char *g_trace_path = NULL; // Chrome trace output, NULL if not tracing
+int g_perf_fd[3] = { -1, -1, -1 }; // hardware cache counters, see perfStart
+uint64_t g_heap_allocs = 0; // heap allocations of the process, see malloc
+uint64_t g_trace_epoch;  // time origin of recorded events in ns
 
-/* Function Prototypes */
-void *solveSudoku(void *);
-bool isValid(int number, int puzzle[GRIDSIZE][GRIDSIZE], int row, int column);
-bool sudokuHelper(int puzzle[GRIDSIZE][GRIDSIZE], int row, int column,
-                  int startV, int nTimes);
 
-char* buffSudoku(int puzzle[GRIDSIZE][GRIDSIZE], double timeo);
 
+/* Digit set of a unit or cell; bit v stands for digit v, up to 25 */
+typedef uint32_t mask_t;
 
-/* Structure to hold data passed to a thread */
+/* Size of the puzzles being solved, chosen at run time, and the
+   constraint graph of that size. Units are numbered rows first (r),
+   then columns (n + c), then boxes (2n + b), like board.unit */
 typedef struct
 {
-    bool completed;  // execution status of thread
-    int board[GRIDSIZE][GRIDSIZE];  // Sudoku matrix passed to a thread
-    int start;  // Starting used in brute-force
-    int row;    // Starting row position to use
-    int col;    // Starting column position to use
-} boardz;
+    int box;     // side of a box, 2 to MAXBOX
+    int n;       // digits, and cells per unit: box * box
+    int cells;   // n * n
+    int npeers;  // cells sharing a unit with a given cell
+    uint8_t unitOf[MAXCELLS][3];      // row, column and box unit of a cell
+    uint8_t boxOf[MAXCELLS];          // box of a cell
+    uint16_t unitCells[3 * MAXN * MAXN]; // n cells per unit
+    uint16_t peers[MAXCELLS * MAXPEERS]; // npeers cells per cell
+    uint64_t zobrist[MAXCELLS][MAXN + 1]; // hash key of a digit in a cell
+} geometry;
 
+geometry g_geo;
 
-/*-------------------------------------------------------------------
- * Purpose:     Checks if an entry does not violate any of the rules of sudoku
- * In arg:      numbers        Entry to check
-                puzzle[][]    Matrix containing Sudoku problem
-                rows          Row number on which to check
-                column        Column number on which to check
+/* Puzzle as read from the input, row by row; 0 marks an empty cell */
+typedef uint8_t grid[MAXCELLS];
 
- * Return val:  A bool which is true if number is allowed at the given position
- */
+/* Sudoku board: the digits already placed in every unit as bitmasks,
+   rows first (unit r), then columns (n + c), then boxes (2n + b), so
+   checking a candidate takes three loads. Then one byte per cell. A
+   9x9 board only touches the first 2 lines of unit and 2 of cell */
+typedef struct
+{
+    mask_t unit[3 * MAXN];
+    uint8_t cell[MAXCELLS];      // 0 for an empty cell, else the digit
+    uint64_t hash;               // xor of the zobrist keys of its digits
+    int filled;                  // cells holding a digit
+} board;
 
-bool isValid(int number, int puzzle[GRIDSIZE][GRIDSIZE], int row, int column) {
-    int i = 0;
+/* One candidate mask per puzzle of a lockstep group. GCC vector
+   extensions lower this to whatever SIMD the target has (two SSE2
+   registers on baseline x86-64, one AVX2 register with -mavx2) */
+typedef uint32_t lanes_t __attribute__((vector_size(LANES * sizeof(mask_t))));
 
-    for (i = 0; i < GRIDSIZE; i++) {
-        if (puzzle[i][column] == number) return 0;
-        if (puzzle[row][i] == number) return 0;
-        if ( number ==
-             puzzle[row/LENGTH*LENGTH+i%LENGTH]
-             [column/LENGTH*LENGTH+i/LENGTH] ) {
-            return 0;
-        }
-    }
-    return 1;
-}
+/* Open subproblems of one puzzle for the tree-splitting scheduler:
+   disjoint subtrees that workers claim in order through next, so the
+   tree is divided between them instead of raced over */
+typedef struct
+{
+    board *node;     // ring of cap boards
+    int cap;
+    int head;        // slot of subproblem 0
+    int count;       // subproblems in the ring
+    int next;        // next subproblem to claim, updated atomically
+} frontier;
 
-/*-------------------------------------------------------------------
- * Purpose:     Calculates solution of puzzle by assigning starting value startV
-                                and using recursive backtracking algorithm
- * In arg:      puzzle[][]    Matrix containing Sudoku problem
-                                rows      Row number of element
-                                column      Column number of element
-                                startV      Starting value from which to find
-                                            legal entries
-                                nTimes      Depth of recursion
- * Return val:  A bool which is true if legal entry found at this location
- */
+frontier g_frontier;
 
-bool sudokuHelper(int puzzle[GRIDSIZE][GRIDSIZE], int row, int col,
-                  int startV, int nTimes)
+/* Cheap hardness features of a puzzle, see extractFeatures */
+typedef struct
 {
-    pthread_rwlock_rdlock(&lock);
+    int clues;          // filled cells of the puzzle
+    int empties;        // cells singles propagation leaves open
+    int hist[4];        // open cells with 2, 3, 4 and 5 or more candidates
+    bool dead;          // propagation found a contradiction
+} features;
 
-    if (1 == g_finished) {
-        return 1;
-    }
-    pthread_rwlock_unlock(&lock);
+/* Hardness model: log10 of the nodes a serial MRV search expands, linear
+   in 1, clues, empties, hist[0..3] counted over 81 cells. Least squares
+   fit on 3304 generated and hard 9x9 puzzles; on 2000 others it is off
+   by 0.37 in log10 on average */
+const double g_model[7] = {
+    4.2599, -0.0785, 0.0038, -0.0113, 0.0038, 0.0093, 0.0017
+};
 
-    // If depth of recursion is 81, then board solved
-    if (BOARDSIZE == nTimes) return 1;
-    // Do a loop of rows and columns
-    col++;
-    if (GRIDSIZE == col){
-        col = 0;
-        row++;
-        if (GRIDSIZE == row ) row = 0;
-    }
+/* Plan for one puzzle, see routePuzzle */
+typedef struct
+{
+    double nodes;       // predicted serial MRV nodes
+    int workers;        // workers if the solve escalates
+    int strategy;       // STRAT_* they run, -1 for the -p portfolio
+} route;
 
+/* Routing by the model when no thread count is given: the count is the
+   pool size and every solve takes the workers its prediction asks for.
+   Predictions are scored against the nodes the solve really took */
+struct
+{
+    bool on;
+    uint64_t n;             // predictions scored
+    uint64_t right;         // serial or escalated, as predicted
+    double err;             // sum of |log10 predicted - log10 actual|
+    double sx, sy, sxx, syy, sxy;   // sums for the correlation of logs
+    uint64_t escalations;   // solves that went to the workers
+    uint64_t workers;       // workers they were given, summed
+} g_route;
 
-    if (0 != puzzle[row][col]){
-        // recursion
-        return sudokuHelper(puzzle ,row, col, startV, nTimes+1);
-    }
+/* Adaptive parallelism, see serialSolve. Solves that the serial search
+   finishes within budget never start the workers */
+struct
+{
+    uint64_t budget;        // serial nodes per solve, 0 to always spawn
+    int split;              // subproblems per worker after escalating
+    bool escalated;         // workers take subtrees from g_frontier
+    uint64_t serial;        // solves finished serially
+    uint64_t parallel;      // solves escalated to the workers
+    uint64_t serial_ns;     // time in the serial search, both kinds
+} g_adapt = { .budget = ADAPT_BUDGET, .split = FRONTIER_SPLIT };
+board g_first;       // first solution counted, see countKernel
+board g_solution;    // board of the worker that ended the last solve
 
+/* Streaming enumeration shared by its workers, see enumPuzzle. Output
+   is only appended under lock, so done, written and offset always
+   describe exactly what the output holds */
+struct
+{
+    pthread_mutex_t lock;   // guards the output and everything below
+    int fd;                 // output file, -1 to stream to sockfd
+    int bits;               // bits per packed cell
+    size_t rec;             // bytes per packed solution
+    const uint8_t *puzzle;  // puzzle being enumerated
+    uint8_t *done;          // per subtree: completely written
+    uint64_t *written;      // per subtree: solutions written so far
+    uint64_t offset;        // bytes of output written
+    uint64_t solutions;     // solutions written
+    const char *checkpoint; // checkpoint file, NULL for none
+    uint64_t saved;         // nowNs() of the last checkpoint
+    bool failed;            // output broke; workers stop
+} g_enum = { .lock = PTHREAD_MUTEX_INITIALIZER, .fd = -1 };
 
-    for (int val = 1; val <= GRIDSIZE; ++val) {
-        if (++startV == 10) {
-            startV = 1;
-        }
-        if (isValid(startV, puzzle, row, col)) {
-            puzzle[row][col] = startV;
-            if (sudokuHelper(puzzle, row, col, startV, nTimes+1))
-                return 1;
-        }
-    }
-    // If no match found then backtrack to previus block
+/* Symmetry of the puzzle group: output cell (r, c) takes digit
+   digit[v] where v is the source cell (row[r], col[c]) of the puzzle,
+   or of its transpose */
+typedef struct
+{
+    bool transpose;
+    uint8_t row[MAXN];          // source row of each output row
+    uint8_t col[MAXN];          // source column of each output column
+    uint8_t digit[MAXN + 1];    // output digit of each source digit
+} transform;
 
-    puzzle[row][col] = 0;
-    return 0;
-} //End of function
+/* Canonical form of a puzzle and the transform that produces it */
+typedef struct
+{
+    uint8_t cells[CACHE_CELLS]; // canonical puzzle, 0 for empty
+    uint64_t hash;
+    transform t;
+} canon_key;
 
+/* Result cache slot. Writers make seq odd while they fill it, so a
+   reader that sees the same even seq before and after copying it has
+   a consistent entry and never takes a lock */
+typedef struct
+{
+    uint32_t seq;
+    uint8_t status;                 // ST_SOLVED or ST_UNSOLVABLE
+    uint64_t hash;                  // 0 for an empty slot
+    uint8_t puzzle[CACHE_CELLS];    // canonical puzzle
+    uint8_t solution[CACHE_CELLS];  // its solution, if solved
+} cache_entry;
 
+/* One shard of the result cache, with its own counters */
+typedef struct
+{
+    cache_entry *slot;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;
+} __attribute__((aligned(CACHELINE))) cache_shard;
 
+cache_shard g_cache[CACHE_SHARDS];
+size_t g_cache_slots = 0;    // slots per shard, a power of two; 0 = off
 
+/* Boards no solution extends, shared by every worker and solve, since
+   being dead depends on the filled cells alone. A slot is one word: the
+   board's hash with its low DEAD_OPEN_BITS replaced by its empty cells,
+   so a relaxed store publishes it whole and a lookup compares the rest.
+   A full bucket, one cache line, gives up the entry with the fewest
+   empty cells, the cheapest to refute again */
+struct
+{
+    uint64_t *slot;
+    uint64_t buckets;           // a power of two; 0 = off
+} g_dead;
 
+/* First page of the solution store file */
+typedef struct
+{
+    char magic[8];       // "sudstore"
+    uint32_t version;    // STORE_VERSION
+    uint32_t box;        // puzzle size the records are for
+    uint64_t slots;      // records after this page, a power of two
+    uint64_t count;      // records in use, updated by the writer
+} store_header;
 
-/*-------------------------------------------------------------------
- * Purpose:     Each thread solves a sudoku puzzle according to the given
-                starting value
- * In arg:      boardz structure
- * Return val:  Ignored
- */
-void *solveSudoku(void * params) {
+/* Record of the solution store. hash is stored last, so a record is
+   visible to readers only once complete, and records are never moved
+   or overwritten. 128 bytes, so no record straddles a page */
+typedef struct
+{
+    uint64_t hash;                      // 0 for an empty slot
+    uint8_t status;                     // ST_SOLVED or ST_UNSOLVABLE
+    uint8_t puzzle[STORE_PACKED];       // canonical puzzle, 4 bits a cell
+    uint8_t solution[STORE_PACKED];     // its solution, see packBoard
+    uint8_t pad[128 - 9 - 2 * STORE_PACKED];
+} store_record;
 
-    boardz *data = (boardz *) params;
-    data->completed = 0;
+/* Solution store mapped from disk, see storeOpen. Any number of
+   processes read it; the one holding the file lock also appends */
+struct
+{
+    store_header *head;     // mapping, NULL if there is no store
+    store_record *rec;      // head->slots records
+    size_t size;            // bytes mapped
+    bool writer;            // this process may append
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t inserts;
+} g_store;
 
-    /* Passing puzzle and start value to recursive function sudokuHelper
-        to find solution */
-    sudokuHelper(data->board, data->row, data->col, data->start, 0);
+/* A distinct puzzle requested by server clients: solved once, however
+   many connections ask for it while it is queued or running */
+typedef struct flight
+{
+    grid puzzle;
+    uint64_t hash;
+    int waiters;            // connections still to take the reply
+    bool done;              // reply is ready
+    char reply[sizeof(buff)];
+    struct flight *chain;   // next in the same g_flights bucket
+    struct flight *next;    // next to solve, while queued
+} flight;
 
-    // apply write lock so as to change value of finished
-    pthread_rwlock_wrlock(&lock);
+/* Server state, see serve. Everything is guarded by lock */
+struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t queued;      // a flight was queued for the solver
+    pthread_cond_t served;      // a flight got its reply
+    pthread_cond_t left;        // a client disconnected
+    int clients;                // connections being served
+    flight *bucket[FLIGHT_BUCKETS]; // flights queued or running
+    flight *head, *tail;        // queue of flights to solve
+    uint64_t depth;             // flights in the queue
+    uint64_t requests;          // puzzles received
+    uint64_t solves;            // flights solved
+    uint64_t coalesced;         // requests that joined an existing flight
+    double cpu;                 // process CPU seconds spent solving
+    double cpu_saved;           // CPU the coalesced requests would have cost
+} g_flights = { .lock = PTHREAD_MUTEX_INITIALIZER,
+                .queued = PTHREAD_COND_INITIALIZER,
+                .served = PTHREAD_COND_INITIALIZER,
+                .left = PTHREAD_COND_INITIALIZER };
 
-    // If any other thread has not finished
-    if (g_finished == 0) {
-        pthread_mutex_lock(&mutex);
-        data->completed = 1;
-        g_finished = 1;
-        pthread_mutex_unlock(&mutex);
+/* Clue symmetries of generated puzzles */
+enum { SYM_NONE, SYM_MIRROR, SYM_180, SYM_90, SYM_COUNT };
+const char *g_sym_names[SYM_COUNT] = { "none", "mirror", "180", "90" };
 
+/* Settings and progress of the puzzle generator, see generatePuzzles */
+struct
+{
+    int count;              // puzzles to make
+    int clues;              // most clues wanted, 0 = as few as possible
+    int sym;                // one of SYM_*
+    double dmin, dmax;      // difficulty band, see ratePuzzle
+    bool rated;             // a -D band was given, puzzles are rated
+    int next;               // puzzles claimed by workers, atomic
+    int made;               // puzzles written, atomic
+    bool failed;            // a worker gave up, see GEN_ATTEMPTS
+    uint64_t grids;         // full grids tried, atomic
+    pthread_mutex_t out;    // keeps output lines whole
+} g_gen = { .dmax = 1e9, .out = PTHREAD_MUTEX_INITIALIZER };
 
-        // calculate time taken
-        clock_gettime(CLOCK_MONOTONIC, &g_finish);
-        g_elapsed = (g_finish.tv_sec - g_start.tv_sec);
-        g_elapsed += (double)(g_finish.tv_nsec - g_start.tv_nsec) / 1000000000;
+/* Candidates of a puzzle as a human solver tracks them */
+typedef struct
+{
+    mask_t cand[MAXCELLS];   // candidate digits, just the digit once placed
+    uint8_t val[MAXCELLS];   // placed digit, 0 while open
+    int open;                // cells not placed yet
+    bool broken;             // some cell or unit ran out of candidates
+} cgrid;
 
+/* Step of the rating ladder; fn makes progress once or returns 0 */
+typedef struct
+{
+    const char *name;
+    double score;            // on the Sudoku Explainer scale
+    int (*fn)(cgrid *);      // NULL for the final trial and error step
+} technique;
 
-        char *b1; // stores puzzle as string to be sent
+/* Progress of a rating run over a batch, see ratePuzzles */
+struct
+{
+    grid *jobs;
+    int count;
+    int next;                // puzzles claimed by workers, atomic
+    int *hardest;            // per puzzle: ladder step, -1 or -2, see ratePuzzle
+} g_rate;
 
-        // Converting solved puzzle to string b1
-        b1 = buffSudoku(data->board, g_elapsed);
-        // Send b1 to server
-        send(sockfd , b1 , strlen(b1) , 0 );
+/* Output side of one enumeration worker */
+typedef struct
+{
+    uint8_t *buf;     // packed solutions held back, ENUM_BUFFER bytes
+    size_t len;       // bytes used in buf
+    int sub;          // subtree being enumerated
+    uint64_t skip;    // solutions of sub that an earlier run wrote
+} enum_out;
 
-        pthread_rwlock_unlock(&lock);
+/* Search kernel specialized for one box size */
+typedef bool (*helper_fn)(board *, int, int, int);
 
-        // Signaling main function to continue execution and terminate process
-        pthread_cond_signal(&is_fin);
-    }
 
-    return 0;
-}
+/* Function Prototypes */
+void *solveSudoku(void *);
+bool isValid(int number, board *b, int cell);
+bool sudokuHelper(board *b, int cell, int startV, int nTimes);
+
+char* buffSudoku(board *b, double timeo);
+char* buffStatus(int status, double timeo);
+char* buffCount(int status, uint64_t count, board *b, double timeo);
+uint64_t cacheCount(size_t off);
+void lockstepPropagate(lanes_t *cand, lanes_t *single, lanes_t *deadp,
+                       int level);
+static inline uint64_t rngNext(uint64_t *state);
 
 
+/* Structure to hold data passed to a thread. Aligned and padded to whole
+   cache lines so that workers never write to each other's lines */
+typedef struct
+{
+    board board;  // Sudoku matrix passed to a thread
+    int id;          // index of the worker, 0 based
+    bool completed;  // execution status of thread
+    int start;  // Starting used in brute-force
+    int cell;   // Starting position to use, row * n + column
+    int strategy;  // STRAT_* search run by the worker
+} __attribute__((aligned(CACHELINE))) boardz;
 
 
+/* Block of arena memory; blocks stay chained across resets */
+typedef struct arena_block
+{
+    struct arena_block *next;
+    size_t size;                 // usable bytes in data
+    char data[] __attribute__((aligned(CACHELINE)));
+} arena_block;
 
+/* Bump allocator owned by one thread. Everything a solve allocates is
+   released at once by arenaReset, so once the blocks have grown to the
+   largest job seen, solving makes no heap allocations at all */
+typedef struct
+{
+    arena_block *first;          // head of the block chain
+    arena_block *cur;            // block being carved
+    size_t used;                 // bytes of cur handed out
+} __attribute__((aligned(CACHELINE))) arena;
 
-/*-------------------------------------------------------------------
- * Purpose:     Converts sudoku board to string for socket transmission
- * In arg:      puzzle[][]    Matrix containing Sudoku problem
-                                timeo          Elapsed time
+arena *g_arenas = NULL;      // slot 0 is main, worker i is i + 1
+__thread arena *t_arena;     // arena of calling thread
 
 
- * Return val:  A string comprising of the elements of the puzzle
+/* One entry of the timeline recorder */
+typedef struct
+{
+    const char *name;  // label shown in the trace viewer
+    uint64_t ts;       // start in ns since g_trace_epoch
+    uint64_t dur;      // duration in ns, 0 for an instant event
+    int arg;           // event specific value (worker id, depth, result)
+} trace_event;
+
+/* Ring of events owned by a single thread, merged only at exit */
+typedef struct
+{
+    uint64_t head;     // number of events ever recorded
+    trace_event ev[TRACE_RING];
+} trace_ring;
+
+trace_ring *g_rings = NULL;      // index 0 is main, worker i is i + 1
+__thread trace_ring *t_ring = NULL; // ring of calling thread, NULL = off
+
+
+/* Locks tracked by the contention profile */
+enum { LK_RDLOCK, LK_WRLOCK, LK_MUTEX, LK_IS_FIN, LK_COUNT };
+
+/* Contention counters of one lock as seen by one thread */
+typedef struct
+{
+    uint64_t acquired;   // successful acquisitions
+    uint64_t contended;  // acquisitions that had to block
+    uint64_t wait_ns;    // total time blocked
+    uint64_t wait_max;
+    uint64_t hold_ns;    // total time between acquire and release
+    uint64_t hold_max;
+    uint64_t since;      // nowNs() of the last acquisition
+    uint64_t pad;        // one thread's LK_COUNT entries fill whole lines
+} lock_stats;
+
+lock_stats *g_lstats = NULL;        // LK_COUNT entries per thread, main first
+__thread lock_stats *t_lstats = NULL; // entries of calling thread, NULL = off
+__thread int t_rw_held;             // LK_RDLOCK or LK_WRLOCK while holding lock
+
+
+/* Outcome of a solve */
+enum { ST_SOLVED, ST_UNSOLVABLE, ST_INVALID, ST_UNIQUE, ST_MULTIPLE,
+       ST_COUNT };
+const char *g_status_names[ST_COUNT] = {
+    "solved", "unsolvable", "invalid", "unique", "multiple"
+};
+
+/* Service metrics of one thread. Only the owning thread writes its slot,
+   so updates are plain stores; readers merge all slots */
+typedef struct
+{
+    uint64_t solves[ST_COUNT];   // finished solves by status
+    uint64_t nodes;              // search nodes expanded
+    uint64_t dead_probes;        // g_dead lookups
+    uint64_t dead_hits;          // subtrees skipped as already refuted
+    uint64_t dead_stores;        // refuted boards recorded
+    uint64_t restarts;           // Luby restarts of the restart strategies
+    uint64_t busy_ns;            // time spent searching
+    uint64_t lat_sum_ns;         // sum of solve latencies
+    uint64_t lat[HDR_BUCKETS];   // solve latency histogram, see hdrIndex
+} __attribute__((aligned(64))) worker_metrics;
+
+/* Searches a worker can run in the race, see -p */
+enum { STRAT_SCAN, STRAT_MRV, STRAT_MRV_REV, STRAT_RESTART, STRAT_SCAN_RESTART,
+       STRAT_DLX, STRAT_SIMD, STRAT_SAT, STRAT_COUNT };
+const char *g_strat_names[STRAT_COUNT] = {
+    "scan", "mrv", "mrv-rev", "restart", "scan-restart", "dlx", "simd", "sat"
+};
+
+/* Portfolio of -p: worker i runs list[i % len], or scan when len is 0.
+   Races entered and won count per strategy, to trim the list by */
+struct
+{
+    int list[PORTFOLIO_MAX];
+    int len;
+    uint64_t races[STRAT_COUNT];
+    uint64_t wins[STRAT_COUNT];
+} g_portfolio;
+
+worker_metrics *g_metrics = NULL;  // slot 0 is main, worker i is i + 1
+int g_metric_slots;                // number of slots in g_metrics
+uint64_t g_metrics_epoch;          // nowNs() when metrics started
+uint64_t g_in_flight;              // solves currently running
+uint64_t g_queue_depth;            // puzzles waiting behind the current one
+const char *g_metrics_path = NULL; // Prometheus textfile, NULL if not written
+__thread worker_metrics *t_metrics; // slot of calling thread
+__thread uint64_t t_nodes;          // nodes of the running search
+__thread uint64_t t_limit;          // t_nodes at which a restart is due
+__thread uint64_t t_rng;            // generator of the thread, see rngNext
+
+
+#if defined(__GLIBC__) && defined(SUD_HEAP_COUNT)
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void *__libc_memalign(size_t align, size_t size);
+void *__libc_valloc(size_t size);
+void *__libc_pvalloc(size_t size);
+
+/*-------------------------------------------------------------------
+ * Purpose:     The allocators of the process, counting each call in
+                g_heap_allocs before handing it to glibc. Defined in the
+                executable, they also catch the allocations of libc and
+                of pthread_create, so tests and benchmarks can check that
+                steady-state solving stays off the heap
+ * In arg:      As the C library functions
+ * Return val:  As the C library functions
  */
-char* buffSudoku(int puzzle[GRIDSIZE][GRIDSIZE], double timeo) {
-    char *buff2 = (char *)malloc(sizeof(buff));
-    int i = 0;
-    int j = 0;
-    int cx = 0, dx;
-    for (i = 0; i < GRIDSIZE; i++) {
-        for (j = 0; j < GRIDSIZE; j++) {
-            dx = snprintf(buff2 + cx, 256 - cx, "%d ", puzzle[i][j]);
-            cx = cx + dx;
-        }
+void *malloc(size_t size) {
+    __atomic_fetch_add(&g_heap_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
 
-    }
-    dx = snprintf(buff2 + cx, 256 - cx, "%f ", timeo);
-    cx = cx + dx;
-    return buff2;
+void *calloc(size_t n, size_t size) {
+    __atomic_fetch_add(&g_heap_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(n, size);
 }
 
+void *realloc(void *p, size_t size) {
+    __atomic_fetch_add(&g_heap_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(p, size);
+}
 
+void *aligned_alloc(size_t align, size_t size) {
+    __atomic_fetch_add(&g_heap_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_memalign(align, size);
+}
 
-int main(int argc, char** argv) {
+void *memalign(size_t align, size_t size) {
+    __atomic_fetch_add(&g_heap_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_memalign(align, size);
+}
 
-    int thread_num;
-    g_finished = 0;
-    int puzzle[GRIDSIZE][GRIDSIZE] = { 0 }; // Array to store problem
+int posix_memalign(void **p, size_t align, size_t size) {
+    if (align % sizeof(void *) || align & (align - 1)) return EINVAL;
+    __atomic_fetch_add(&g_heap_allocs, 1, __ATOMIC_RELAXED);
+    *p = __libc_memalign(align, size);
+    return *p ? 0 : ENOMEM;
+}
 
+void *valloc(size_t size) {
+    __atomic_fetch_add(&g_heap_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_valloc(size);
+}
 
-    pthread_mutex_init(&mutex, NULL);
-    pthread_cond_init(&is_fin, NULL);
-    pthread_rwlockattr_init (&mylock_attr);
-    // Preferring writer-locks for rwlocks
-    pthread_rwlockattr_setkind_np(&mylock_attr,
-          PTHREAD_RWLOCK_PREFER_WRITER_NP);
-    pthread_rwlock_init(&lock , &mylock_attr);
+void *pvalloc(size_t size) {
+    __atomic_fetch_add(&g_heap_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_pvalloc(size);
+}
+#endif
 
+/*-------------------------------------------------------------------
+ * Purpose:     Allocates a whole number of cache lines
+ * In arg:      size      Bytes to allocate
+ * Return val:  Memory aligned to a cache line; exits if none is left
+ */
+void *xmalloc(size_t size) {
+    void *p = aligned_alloc(CACHELINE, (size + CACHELINE - 1)
+                                       / CACHELINE * CACHELINE);
+    if (NULL == p) {
+        perror("aligned_alloc");
+        exit(1);
+    }
+    return p;
+}
 
-    // Converting problem from **argv to 2d integer array
-    int c3 = 1;
-    for (int c = 0; c < GRIDSIZE; c++) {
-        for (int c2 = 0; c2 < GRIDSIZE; c2++, c3++) {
-            puzzle[c][c2] = atoi(argv[c3]);
+/*-------------------------------------------------------------------
+ * Purpose:     Carves memory out of an arena, moving on to the next
+                block of the chain, or a new one, when cur is full
+ * In arg:      a         Arena owned by the calling thread
+                size      Bytes needed
+                align     Power of two alignment, at most CACHELINE
+ * Return val:  Memory valid until the next arenaReset
+ */
+void *arenaAlloc(arena *a, size_t size, size_t align) {
+    size_t at = (a->used + align - 1) & ~(align - 1);
+    while (NULL == a->cur || at + size > a->cur->size) {
+        if (a->cur && a->cur->next) {
+            a->cur = a->cur->next;
+        } else {
+            size_t n = size > ARENA_BLOCK ? size : ARENA_BLOCK;
+            arena_block *blk = xmalloc(sizeof(arena_block) + n);
+            blk->next = NULL;
+            blk->size = n;
+            if (a->cur) a->cur->next = blk;
+            else a->first = blk;
+            a->cur = blk;
         }
+        at = 0;
     }
+    a->used = at + size;
+    return a->cur->data + at;
+}
 
-    // Getting number of threads to use
-    thread_num = atoi(argv[c3]);
-    // thread_num = 1;
+/*-------------------------------------------------------------------
+ * Purpose:     Releases everything allocated from an arena in O(1); the
+                blocks are kept for the next job
+ * In arg:      a         Arena to reset
+ */
+void arenaReset(arena *a) {
+    a->cur = a->first;
+    a->used = 0;
+}
 
-    // Initializing socket for client side
-    struct sockaddr_in serv_addr;
+/*-------------------------------------------------------------------
+ * Purpose:     Reads the monotonic clock
+ * Return val:  Nanoseconds since an arbitrary fixed point
+ */
+uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
 
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    memset(&serv_addr, '0', sizeof(serv_addr));
-    serv_addr.sin_family = AF_INET;
-    serv_addr.sin_port = htons(PORT);
-    inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr);
-    connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr));
+/*-------------------------------------------------------------------
+ * Purpose:     Timestamp for a trace span, skipping the clock read when
+                the calling thread is not recording
+ * Return val:  Nanoseconds since g_trace_epoch, 0 if tracing is off
+ */
+uint64_t traceNow(void) {
+    return t_ring ? nowNs() - g_trace_epoch : 0;
+}
 
+/*-------------------------------------------------------------------
+ * Purpose:     Appends an event to the ring of the calling thread
+ * In arg:      name      Event label, must be a string literal
+                ts        Start of the event as returned by traceNow
+                dur       Duration in ns, 0 for an instant event
+                arg       Event specific value
+ */
+void traceRecord(const char *name, uint64_t ts, uint64_t dur, int arg) {
+    if (NULL == t_ring) return;
+    trace_event *e = &t_ring->ev[t_ring->head++ % TRACE_RING];
+    e->name = name;
+    e->ts = ts;
+    e->dur = dur;
+    e->arg = arg;
+}
 
+/*-------------------------------------------------------------------
+ * Purpose:     Closes a span opened with traceNow
+ * In arg:      name      Event label
+                t0        Value of traceNow at the start of the span
+                arg       Event specific value
+ */
+void traceSpan(const char *name, uint64_t t0, int arg) {
+    if (NULL == t_ring) return;
+    uint64_t t1 = traceNow();
+    traceRecord(name, t0, t1 > t0 ? t1 - t0 : 1, arg);
+}
 
-    srand(time(NULL));
+/*-------------------------------------------------------------------
+ * Purpose:     Bookkeeping once a lock wrapper holds its lock. Blocking
+                waits go to the trace, every acquisition to the lock
+                profile of the calling thread
+ * In arg:      id        Lock being acquired, one of LK_*
+                name      Trace label of a blocking wait
+                t0        nowNs() before blocking, 0 if the try-lock won
+ */
+void lockAcquired(int id, const char *name, uint64_t t0) {
+    if (0 == t0 && NULL == t_lstats) return;
+    uint64_t t1 = nowNs();
 
-    boardz *p[thread_num];
+    if (t0) traceRecord(name, t0 - g_trace_epoch, t1 - t0, 0);
+    if (t_lstats) {
+        lock_stats *ls = &t_lstats[id];
+        ls->acquired++;
+        if (t0) {
+            ls->contended++;
+            ls->wait_ns += t1 - t0;
+            if (t1 - t0 > ls->wait_max) ls->wait_max = t1 - t0;
+        }
+        ls->since = t1;
+    }
+}
 
-    // Allocating memory and initializing structures for thread parameters
-    for (int i = 0; i < thread_num; i++) {
-        p[i] = (boardz *) malloc (sizeof(boardz));
+/*-------------------------------------------------------------------
+ * Purpose:     Accounts the hold time of a lock about to be released
+ * In arg:      id        Lock being released, one of LK_*
+ */
+void lockReleased(int id) {
+    if (NULL == t_lstats) return;
+    lock_stats *ls = &t_lstats[id];
+    uint64_t held = nowNs() - ls->since;
+    ls->hold_ns += held;
+    if (held > ls->hold_max) ls->hold_max = held;
+}
 
-        memcpy(p[i]->board, puzzle, GRIDSIZE * GRIDSIZE * sizeof(int));
+/*-------------------------------------------------------------------
+ * Purpose:     Lock wrappers; when observed, an uncontended acquisition
+                costs one try-lock and only blocking waits are timed
+ * In arg:      l         Lock to acquire or release
+ */
+void rdLock(pthread_rwlock_t *l) {
+    uint64_t t0 = 0;
+    if (NULL == t_ring && NULL == t_lstats) {
+        pthread_rwlock_rdlock(l);
+        return;
+    }
+    if (0 != pthread_rwlock_tryrdlock(l)) {
+        t0 = nowNs();
+        pthread_rwlock_rdlock(l);
+    }
+    lockAcquired(LK_RDLOCK, "wait rdlock", t0);
+    t_rw_held = LK_RDLOCK;
+}
 
-        p[i]->completed = 0;
-        p[i]->start = (float)GRIDSIZE/thread_num * i;
-        p[i]->row = rand() % 9;
-        p[i]->col = rand() % 9;
+void wrLock(pthread_rwlock_t *l) {
+    uint64_t t0 = 0;
+    if (NULL == t_ring && NULL == t_lstats) {
+        pthread_rwlock_wrlock(l);
+        return;
     }
+    if (0 != pthread_rwlock_trywrlock(l)) {
+        t0 = nowNs();
+        pthread_rwlock_wrlock(l);
+    }
+    lockAcquired(LK_WRLOCK, "wait wrlock", t0);
+    t_rw_held = LK_WRLOCK;
+}
 
+void rwUnlock(pthread_rwlock_t *l) {
+    lockReleased(t_rw_held);
+    pthread_rwlock_unlock(l);
+}
 
-    // Start measuring time
-    clock_gettime(CLOCK_MONOTONIC, &g_start);
+void mtxLock(pthread_mutex_t *m) {
+    uint64_t t0 = 0;
+    if (NULL == t_ring && NULL == t_lstats) {
+        pthread_mutex_lock(m);
+        return;
+    }
+    if (0 != pthread_mutex_trylock(m)) {
+        t0 = nowNs();
+        pthread_mutex_lock(m);
+    }
+    lockAcquired(LK_MUTEX, "wait mutex", t0);
+}
 
-    pthread_t t[thread_num];
-    // Starting threads
-    for (int i = 0; i < thread_num; i++) {
+void mtxUnlock(pthread_mutex_t *m) {
+    lockReleased(LK_MUTEX);
+    pthread_mutex_unlock(m);
+}
 
-        pthread_create(&t[i], NULL, solveSudoku, (void *) p[i]);
+/*-------------------------------------------------------------------
+ * Purpose:     pthread_cond_wait wrapper; time blocked on the condition
+                counts as wait on the condvar, not as mutex hold time
+ * In arg:      c         Condition to wait on
+                m         Mutex held by the caller
+ */
+void condWait(pthread_cond_t *c, pthread_mutex_t *m) {
+    if (NULL == t_ring && NULL == t_lstats) {
+        pthread_cond_wait(c, m);
+        return;
     }
+    lockReleased(LK_MUTEX);
+    uint64_t t0 = nowNs();
+    pthread_cond_wait(c, m);
+    lockAcquired(LK_IS_FIN, "wait is_fin", t0);
+    if (t_lstats) t_lstats[LK_MUTEX].since = t_lstats[LK_IS_FIN].since;
+}
 
+/*-------------------------------------------------------------------
+ * Purpose:     Prints the lock profile of every thread and per lock
+                totals to stderr
+ * In arg:      nthreads  Number of profiled threads (workers + main)
+ */
+void lockReport(int nthreads) {
+    static const char *names[LK_COUNT] = {
+        "lock (rd)", "lock (wr)", "mutex", "is_fin"
+    };
 
-    pthread_mutex_lock(&mutex);
+    fprintf(stderr, "%-10s %-9s %10s %10s %12s %10s %12s %10s\n",
+            "lock", "thread", "acquired", "contended", "wait_us",
+            "wait_max", "hold_us", "hold_max");
+    for (int id = 0; id < LK_COUNT; id++) {
+        lock_stats sum = { 0 };
+        for (int t = 0; t < nthreads; t++) {
+            lock_stats *ls = &g_lstats[t * LK_COUNT + id];
+            if (0 == ls->acquired) continue;
+            char who[24];
+            if (0 == t) snprintf(who, sizeof(who), "main");
+            else snprintf(who, sizeof(who), "worker %d", t - 1);
+            fprintf(stderr, "%-10s %-9s %10llu %10llu %12.1f %10.1f "
+                    "%12.1f %10.1f\n", names[id], who,
+                    (unsigned long long)ls->acquired,
+                    (unsigned long long)ls->contended, ls->wait_ns / 1e3,
+                    ls->wait_max / 1e3, ls->hold_ns / 1e3, ls->hold_max / 1e3);
+            sum.acquired += ls->acquired;
+            sum.contended += ls->contended;
+            sum.wait_ns += ls->wait_ns;
+            sum.hold_ns += ls->hold_ns;
+            if (ls->wait_max > sum.wait_max) sum.wait_max = ls->wait_max;
+            if (ls->hold_max > sum.hold_max) sum.hold_max = ls->hold_max;
+        }
+        if (0 == sum.acquired) continue;
+        fprintf(stderr, "%-10s %-9s %10llu %10llu %12.1f %10.1f %12.1f "
+                "%10.1f\n", names[id], "total",
+                (unsigned long long)sum.acquired,
+                (unsigned long long)sum.contended, sum.wait_ns / 1e3,
+                sum.wait_max / 1e3, sum.hold_ns / 1e3, sum.hold_max / 1e3);
+    }
+}
 
-    // Waiting till one of the threads has completed execution
-    while (0 == g_finished)  pthread_cond_wait(&is_fin, &mutex);
+/*-------------------------------------------------------------------
+ * Purpose:     Single-writer counter updates; a relaxed load and store
+                instead of a locked read-modify-write, readable at any time
+ * In arg:      c         Counter owned by the calling thread
+                v         Amount to add, or value to set
+ */
+static inline void statAdd(uint64_t *c, uint64_t v) {
+    __atomic_store_n(c, __atomic_load_n(c, __ATOMIC_RELAXED) + v,
+                     __ATOMIC_RELAXED);
+}
 
+static inline void statSet(uint64_t *c, uint64_t v) {
+    __atomic_store_n(c, v, __ATOMIC_RELAXED);
+}
 
-    pthread_mutex_unlock(&mutex);
-    pthread_mutex_destroy(&mutex);
-    pthread_rwlock_destroy(&lock);
-    pthread_cond_destroy(&is_fin);
-    return 0;
+static inline uint64_t statGet(const uint64_t *c) {
+    return __atomic_load_n(c, __ATOMIC_RELAXED);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Maps a value to its HDR-style histogram bucket: values
+                below HDR_SUB are exact, larger ones keep 4 significant
+                bits, i.e. a relative error under 1/16
+ * In arg:      v         Value to bucket
+ * Return val:  Bucket index below HDR_BUCKETS
+ */
+int hdrIndex(uint64_t v) {
+    if (v < HDR_SUB) return (int)v;
+    int e = 63 - __builtin_clzll(v);
+    return (e - 3) * HDR_SUB + (int)((v >> (e - 4)) & (HDR_SUB - 1));
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Smallest value that maps to a histogram bucket
+ * In arg:      idx       Bucket index
+ * Return val:  Lower bound of the bucket
+ */
+uint64_t hdrLow(int idx) {
+    if (idx < HDR_SUB) return idx;
+    int e = idx / HDR_SUB + 3;
+    return (uint64_t)(HDR_SUB + idx % HDR_SUB) << (e - 4);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Records a finished solve in the calling thread's slot
+ * In arg:      status    One of ST_*
+                seconds   Solve latency
+ */
+void metricsSolve(int status, double seconds) {
+    uint64_t ns = (uint64_t)(seconds * 1e9);
+    statAdd(&t_metrics->solves[status], 1);
+    statAdd(&t_metrics->lat_sum_ns, ns);
+    statAdd(&t_metrics->lat[hdrIndex(ns)], 1);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Writes all metrics in Prometheus text exposition format.
+                The file is replaced atomically so a textfile collector
+                never reads a partial scrape
+ * In arg:      path      Output file
+                workers   Number of worker threads per solve
+ * Return val:  0 on success, -1 if the file could not be written
+ */
+int metricsWrite(const char *path, int workers) {
+    static const double le[] = {
+        1e-5, 2.5e-5, 5e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3,
+        1e-2, 2.5e-2, 5e-2, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+    };
+    worker_metrics sum;
+    memset(&sum, 0, sizeof(sum));
+    for (int w = 0; w < g_metric_slots; w++) {
+        worker_metrics *m = &g_metrics[w];
+        for (int st = 0; st < ST_COUNT; st++) {
+            sum.solves[st] += statGet(&m->solves[st]);
+        }
+        sum.nodes += statGet(&m->nodes);
+        sum.dead_probes += statGet(&m->dead_probes);
+        sum.dead_hits += statGet(&m->dead_hits);
+        sum.dead_stores += statGet(&m->dead_stores);
+        sum.restarts += statGet(&m->restarts);
+        sum.busy_ns += statGet(&m->busy_ns);
+        sum.lat_sum_ns += statGet(&m->lat_sum_ns);
+        for (int b = 0; b < HDR_BUCKETS; b++) {
+            sum.lat[b] += statGet(&m->lat[b]);
+        }
+    }
+    uint64_t total = 0;
+    for (int st = 0; st < ST_COUNT; st++) total += sum.solves[st];
+    double wall = (nowNs() - g_metrics_epoch) / 1e9;
+    double busy = sum.busy_ns / 1e9;
+
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (NULL == f) {
+        perror(tmp);
+        return -1;
+    }
+    fprintf(f, "# HELP sudoku_solves_total Puzzles finished.\n"
+            "# TYPE sudoku_solves_total counter\n"
+            "sudoku_solves_total %llu\n", (unsigned long long)total);
+    fprintf(f, "# HELP sudoku_solve_status_total Puzzles finished by status.\n"
+            "# TYPE sudoku_solve_status_total counter\n");
+    for (int st = 0; st < ST_COUNT; st++) {
+        fprintf(f, "sudoku_solve_status_total{status=\"%s\"} %llu\n",
+                g_status_names[st], (unsigned long long)sum.solves[st]);
+    }
+    fprintf(f, "# HELP sudoku_solve_duration_seconds Solve latency.\n"
+            "# TYPE sudoku_solve_duration_seconds histogram\n");
+    uint64_t cum = 0;
+    int b = 0;
+    for (size_t k = 0; k < sizeof(le) / sizeof(le[0]); k++) {
+        for (; b < HDR_BUCKETS && hdrLow(b) < le[k] * 1e9; b++) {
+            cum += sum.lat[b];
+        }
+        fprintf(f, "sudoku_solve_duration_seconds_bucket{le=\"%g\"} %llu\n",
+                le[k], (unsigned long long)cum);
+    }
+    fprintf(f, "sudoku_solve_duration_seconds_bucket{le=\"+Inf\"} %llu\n"
+            "sudoku_solve_duration_seconds_sum %.9f\n"
+            "sudoku_solve_duration_seconds_count %llu\n",
+            (unsigned long long)total, sum.lat_sum_ns / 1e9,
+            (unsigned long long)total);
+    fprintf(f, "# HELP sudoku_jobs_in_flight Solves currently running.\n"
+            "# TYPE sudoku_jobs_in_flight gauge\n"
+            "sudoku_jobs_in_flight %llu\n",
+            (unsigned long long)statGet(&g_in_flight));
+    fprintf(f, "# HELP sudoku_queue_depth Puzzles waiting to be solved.\n"
+            "# TYPE sudoku_queue_depth gauge\n"
+            "sudoku_queue_depth %llu\n",
+            (unsigned long long)statGet(&g_queue_depth));
+    fprintf(f, "# HELP sudoku_search_nodes_total Search nodes expanded.\n"
+            "# TYPE sudoku_search_nodes_total counter\n"
+            "sudoku_search_nodes_total %llu\n",
+            (unsigned long long)sum.nodes);
+    fprintf(f, "# HELP sudoku_heap_allocations_total Heap allocations of "
+            "the process, 0 unless built with -DSUD_HEAP_COUNT.\n"
+            "# TYPE sudoku_heap_allocations_total counter\n"
+            "sudoku_heap_allocations_total %llu\n", (unsigned long long)
+            __atomic_load_n(&g_heap_allocs, __ATOMIC_RELAXED));
+    fprintf(f, "# HELP sudoku_worker_busy_seconds_total Worker search time.\n"
+            "# TYPE sudoku_worker_busy_seconds_total counter\n"
+            "sudoku_worker_busy_seconds_total %.9f\n", busy);
+    fprintf(f, "# HELP sudoku_worker_utilization Busy share of worker time.\n"
+            "# TYPE sudoku_worker_utilization gauge\n"
+            "sudoku_worker_utilization %.6f\n",
+            wall > 0 ? busy / (wall * workers) : 0);
+    fprintf(f, "# HELP sudoku_nodes_per_second Nodes per busy worker second.\n"
+            "# TYPE sudoku_nodes_per_second gauge\n"
+            "sudoku_nodes_per_second %.1f\n", busy > 0 ? sum.nodes / busy : 0);
+    if (g_dead.buckets) {
+        fprintf(f, "# HELP sudoku_dead_lookups_total Refuted board lookups.\n"
+                "# TYPE sudoku_dead_lookups_total counter\n"
+                "sudoku_dead_lookups_total{result=\"hit\"} %llu\n"
+                "sudoku_dead_lookups_total{result=\"miss\"} %llu\n"
+                "# HELP sudoku_dead_stores_total Refuted boards recorded.\n"
+                "# TYPE sudoku_dead_stores_total counter\n"
+                "sudoku_dead_stores_total %llu\n",
+                (unsigned long long)sum.dead_hits,
+                (unsigned long long)(sum.dead_probes - sum.dead_hits),
+                (unsigned long long)sum.dead_stores);
+    }
+    if (g_cache_slots) {
+        fprintf(f, "# HELP sudoku_cache_lookups_total Result cache lookups.\n"
+                "# TYPE sudoku_cache_lookups_total counter\n"
+                "sudoku_cache_lookups_total{result=\"hit\"} %llu\n"
+                "sudoku_cache_lookups_total{result=\"miss\"} %llu\n"
+                "# HELP sudoku_cache_inserts_total Results stored.\n"
+                "# TYPE sudoku_cache_inserts_total counter\n"
+                "sudoku_cache_inserts_total %llu\n",
+                (unsigned long long)cacheCount(offsetof(cache_shard, hits)),
+                (unsigned long long)cacheCount(offsetof(cache_shard, misses)),
+                (unsigned long long)cacheCount(offsetof(cache_shard, inserts)));
+    }
+    if (g_adapt.budget) {
+        fprintf(f, "# HELP sudoku_adaptive_solves_total Searched solves by "
+                "where they finished.\n"
+                "# TYPE sudoku_adaptive_solves_total counter\n"
+                "sudoku_adaptive_solves_total{path=\"serial\"} %llu\n"
+                "sudoku_adaptive_solves_total{path=\"parallel\"} %llu\n"
+                "# HELP sudoku_adaptive_budget_nodes Serial node budget.\n"
+                "# TYPE sudoku_adaptive_budget_nodes gauge\n"
+                "sudoku_adaptive_budget_nodes %llu\n"
+                "# HELP sudoku_adaptive_serial_seconds_total Time in the "
+                "serial search.\n"
+                "# TYPE sudoku_adaptive_serial_seconds_total counter\n"
+                "sudoku_adaptive_serial_seconds_total %.6f\n",
+                (unsigned long long)statGet(&g_adapt.serial),
+                (unsigned long long)statGet(&g_adapt.parallel),
+                (unsigned long long)g_adapt.budget,
+                statGet(&g_adapt.serial_ns) / 1e9);
+    }
+    if (g_portfolio.len) {
+        fprintf(f, "# HELP sudoku_portfolio_races_total Solves a strategy "
+                "raced in.\n# TYPE sudoku_portfolio_races_total counter\n");
+        for (int k = 0; k < STRAT_COUNT; k++) {
+            fprintf(f, "sudoku_portfolio_races_total{strategy=\"%s\"} %llu\n",
+                    g_strat_names[k], (unsigned long long)g_portfolio.races[k]);
+        }
+        fprintf(f, "# HELP sudoku_portfolio_wins_total Solves a strategy "
+                "finished first.\n"
+                "# TYPE sudoku_portfolio_wins_total counter\n");
+        for (int k = 0; k < STRAT_COUNT; k++) {
+            fprintf(f, "sudoku_portfolio_wins_total{strategy=\"%s\"} %llu\n",
+                    g_strat_names[k], (unsigned long long)g_portfolio.wins[k]);
+        }
+        fprintf(f, "# HELP sudoku_restarts_total Luby restarts of the "
+                "restart strategies.\n# TYPE sudoku_restarts_total counter\n"
+                "sudoku_restarts_total %llu\n",
+                (unsigned long long)sum.restarts);
+    }
+    if (g_flights.requests) {
+        pthread_mutex_lock(&g_flights.lock);
+        fprintf(f, "# HELP sudoku_server_requests_total Puzzles received.\n"
+                "# TYPE sudoku_server_requests_total counter\n"
+                "sudoku_server_requests_total %llu\n"
+                "# HELP sudoku_server_coalesced_total Requests answered by "
+                "another request's solve.\n"
+                "# TYPE sudoku_server_coalesced_total counter\n"
+                "sudoku_server_coalesced_total %llu\n"
+                "# HELP sudoku_server_cpu_saved_seconds_total CPU the "
+                "coalesced requests would have cost.\n"
+                "# TYPE sudoku_server_cpu_saved_seconds_total counter\n"
+                "sudoku_server_cpu_saved_seconds_total %.6f\n",
+                (unsigned long long)g_flights.requests,
+                (unsigned long long)g_flights.coalesced, g_flights.cpu_saved);
+        pthread_mutex_unlock(&g_flights.lock);
+    }
+    if (g_store.head) {
+        fprintf(f, "# HELP sudoku_store_lookups_total Solution store lookups.\n"
+                "# TYPE sudoku_store_lookups_total counter\n"
+                "sudoku_store_lookups_total{result=\"hit\"} %llu\n"
+                "sudoku_store_lookups_total{result=\"miss\"} %llu\n"
+                "# HELP sudoku_store_records Results in the solution store.\n"
+                "# TYPE sudoku_store_records gauge\n"
+                "sudoku_store_records %llu\n",
+                (unsigned long long)statGet(&g_store.hits),
+                (unsigned long long)statGet(&g_store.misses),
+                (unsigned long long)statGet(&g_store.head->count));
+    }
+    if (0 != fclose(f) || 0 != rename(tmp, path)) {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Opens process-wide hardware counters for cache references,
+                cache misses and L1d read misses. Must run before the
+                workers are created; they inherit the counters
+ * Return val:  A bool which is false if the kernel offers no counters
+ */
+bool perfStart(void) {
+    static const uint64_t config[3] = {
+        PERF_COUNT_HW_CACHE_REFERENCES,
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+    };
+    for (int k = 0; k < 3; k++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = k < 2 ? PERF_TYPE_HARDWARE : PERF_TYPE_HW_CACHE;
+        attr.config = config[k];
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        g_perf_fd[k] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (g_perf_fd[k] < 0) {
+            fprintf(stderr, "perf counters unavailable: %s\n",
+                    strerror(errno));
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Prints the counters opened by perfStart to stderr
+ * In arg:      solves    Number of solves, for per-solve figures
+ */
+void perfReport(int solves) {
+    uint64_t v[3];
+    for (int k = 0; k < 3; k++) {
+        if (g_perf_fd[k] < 0 || sizeof(v[k]) != read(g_perf_fd[k], &v[k],
+                                                      sizeof(v[k]))) return;
+        close(g_perf_fd[k]);
+    }
+    if (solves < 1) solves = 1;
+    fprintf(stderr, "perf: cache-references %llu, cache-misses %llu "
+            "(%.2f%%), L1d-read-misses %llu\n"
+            "perf: per solve %.0f cache-misses, %.0f L1d-read-misses\n",
+            (unsigned long long)v[0], (unsigned long long)v[1],
+            v[0] ? 100.0 * v[1] / v[0] : 0, (unsigned long long)v[2],
+            (double)v[1] / solves, (double)v[2] / solves);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Writes all rings as Chrome trace-event JSON
+ * In arg:      path      Output file
+                nrings    Number of rings (workers + main)
+ * Return val:  0 on success, -1 if the file could not be written
+ */
+int traceWrite(const char *path, int nrings) {
+    FILE *f = fopen(path, "w");
+    if (NULL == f) {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (int r = 0; r < nrings; r++) {
+        trace_ring *ring = &g_rings[r];
+        uint64_t first = ring->head > TRACE_RING ? ring->head - TRACE_RING : 0;
+
+        if (0 == r) {
+            fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                    "\"tid\":0,\"args\":{\"name\":\"main\"}}");
+        } else {
+            fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                    "\"tid\":%d,\"args\":{\"name\":\"worker %d\"}}", r, r - 1);
+        }
+        if (first > 0) {
+            fprintf(f, ",\n{\"name\":\"dropped %llu events\",\"ph\":\"i\","
+                    "\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":0}",
+                    (unsigned long long)first, r);
+        }
+        for (uint64_t k = first; k < ring->head; k++) {
+            trace_event *e = &ring->ev[k % TRACE_RING];
+            if (e->dur) {
+                fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,"
+                        "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                        "\"args\":{\"v\":%d}}", e->name, r,
+                        e->ts / 1000.0, e->dur / 1000.0, e->arg);
+            } else {
+                fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\","
+                        "\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                        "\"args\":{\"v\":%d}}", e->name, r,
+                        e->ts / 1000.0, e->arg);
+            }
+        }
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f);
+}
+
+
+/*-------------------------------------------------------------------
+ * Purpose:     Builds the constraint graph tables of a geometry, so that
+                kernels walk flat index lists instead of computing
+                coordinates with divisions
+ * In arg:      box       Side of a box, 2 to MAXBOX
+ * Out arg:     g         Geometry with all tables filled in
+ */
+void geometryInit(geometry *g, int box) {
+    const int n = box * box;
+    g->box = box;
+    g->n = n;
+    g->cells = n * n;
+    g->npeers = 3 * (n - 1) - 2 * (box - 1);
+
+    for (int cell = 0; cell < g->cells; cell++) {
+        int r = cell / n, c = cell % n;
+        int bx = r / box * box + c / box;
+        g->boxOf[cell] = bx;
+        g->unitOf[cell][0] = r;
+        g->unitOf[cell][1] = n + c;
+        g->unitOf[cell][2] = 2 * n + bx;
+        g->unitCells[r * n + c] = cell;
+        g->unitCells[(n + c) * n + r] = cell;
+        g->unitCells[(2 * n + bx) * n + r % box * box + c % box] = cell;
+    }
+    uint64_t seed = 0x9E3779B97F4A7C15ull;
+    for (int cell = 0; cell < g->cells; cell++) {
+        for (int v = 0; v <= n; v++) g->zobrist[cell][v] = rngNext(&seed);
+    }
+    for (int cell = 0; cell < g->cells; cell++) {
+        uint16_t *peer = &g->peers[cell * g->npeers];
+        int k = 0;
+        for (int other = 0; other < g->cells; other++) {
+            if (other == cell) continue;
+            if (other / n == cell / n || other % n == cell % n
+                || g->boxOf[other] == g->boxOf[cell]) {
+                peer[k++] = other;
+            }
+        }
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Digits already used in the row, column and box of a cell
+ * In arg:      b             Board
+                cell          Index of the cell, row by row
+ * Return val:  Mask with bit v set if digit v is taken
+ */
+KERNEL mask_t usedAt(const board *b, int cell) {
+    const uint8_t *u = g_geo.unitOf[cell];
+    return b->unit[u[0]] | b->unit[u[1]] | b->unit[u[2]];
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Places or removes a digit, keeping the unit masks in step
+ * In arg:      b             Board to update
+                cell          Index of the cell, row by row
+                number        Digit placed in / removed from the cell
+ */
+KERNEL void placeAt(board *b, int cell, int number) {
+    const uint8_t *u = g_geo.unitOf[cell];
+    b->cell[cell] = number;
+    b->hash ^= g_geo.zobrist[cell][number];
+    b->filled++;
+    b->unit[u[0]] |= (mask_t)1 << number;
+    b->unit[u[1]] |= (mask_t)1 << number;
+    b->unit[u[2]] |= (mask_t)1 << number;
+}
+
+KERNEL void clearAt(board *b, int cell, int number) {
+    const uint8_t *u = g_geo.unitOf[cell];
+    b->cell[cell] = 0;
+    b->hash ^= g_geo.zobrist[cell][number];
+    b->filled--;
+    b->unit[u[0]] &= ~((mask_t)1 << number);
+    b->unit[u[1]] &= ~((mask_t)1 << number);
+    b->unit[u[2]] &= ~((mask_t)1 << number);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Checks if an entry does not violate any of the rules of sudoku
+ * In arg:      numbers        Entry to check
+                b             Board containing Sudoku problem
+                cell          Index of the cell, row by row
+
+ * Return val:  A bool which is true if number is allowed at the given position
+ */
+
+bool isValid(int number, board *b, int cell) {
+    return !(usedAt(b, cell) & ((mask_t)1 << number));
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Looks a board up in g_dead
+ * In arg:      b         Board deadKeeps accepts
+ * Return val:  A bool which is true if some search refuted it already
+ */
+KERNEL bool deadFind(const board *b) {
+    const uint64_t *slot = g_dead.slot + DEAD_BUCKET
+                         * (b->hash >> DEAD_OPEN_BITS & (g_dead.buckets - 1));
+    statAdd(&t_metrics->dead_probes, 1);
+    for (int i = 0; i < DEAD_BUCKET; i++) {
+        uint64_t v = __atomic_load_n(&slot[i], __ATOMIC_RELAXED);
+        if (0 == (v ^ b->hash) >> DEAD_OPEN_BITS) {
+            statAdd(&t_metrics->dead_hits, 1);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Records a board no solution extends in g_dead, in an
+                empty slot of its bucket or over its shallowest entry
+ * In arg:      b         Refuted board deadKeeps accepts
+ */
+void deadPut(const board *b) {
+    uint64_t *slot = g_dead.slot + DEAD_BUCKET
+                   * (b->hash >> DEAD_OPEN_BITS & (g_dead.buckets - 1));
+    const uint64_t low = (1u << DEAD_OPEN_BITS) - 1;
+    uint64_t least = UINT64_MAX;
+    int victim = 0;
+    for (int i = 0; i < DEAD_BUCKET; i++) {
+        uint64_t v = __atomic_load_n(&slot[i], __ATOMIC_RELAXED);
+        if (0 == v) {
+            victim = i;
+            break;
+        }
+        if ((v & low) < least) {
+            least = v & low;
+            victim = i;
+        }
+    }
+    __atomic_store_n(&slot[victim], (b->hash & ~low)
+                     | (uint64_t)(g_geo.cells - b->filled), __ATOMIC_RELAXED);
+    statAdd(&t_metrics->dead_stores, 1);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Tells a search whether g_dead is worth a lookup or an
+                insert for a board
+ * In arg:      b         Board
+ * Return val:  A bool which is true if the table is on and at least
+                DEAD_MIN_OPEN percent of the board's cells are empty.
+                Deeper boards are cheaper to refute again than to look up
+ */
+KERNEL bool deadKeeps(const board *b) {
+    return g_dead.buckets
+           && 100 * (g_geo.cells - b->filled) >= DEAD_MIN_OPEN * g_geo.cells;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Allocates g_dead
+ * In arg:      entries   Boards to hold at least, rounded up to whole
+                          buckets of a power of two, at most
+                          DEAD_MAX_BUCKETS of them
+ * Return val:  0 on success, -1 if the table could not be allocated
+ */
+int deadInit(size_t entries) {
+    size_t buckets = 1;
+    while (buckets * DEAD_BUCKET < entries && buckets < DEAD_MAX_BUCKETS) {
+        buckets *= 2;
+    }
+    size_t size = buckets * DEAD_BUCKET * sizeof(uint64_t);
+    g_dead.slot = aligned_alloc(CACHELINE, size);
+    if (NULL == g_dead.slot) {
+        fprintf(stderr, "-Z: cannot allocate %zu bytes\n", size);
+        return -1;
+    }
+    memset(g_dead.slot, 0, size);
+    g_dead.buckets = buckets;
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Builds a board from a puzzle of the current geometry
+ * In arg:      g             Cells of the puzzle, row by row, 0 = empty
+ * Out arg:     b             Packed board
+ * Return val:  A bool which is false if two givens conflict or a cell
+                holds a value above n
+ */
+bool boardLoad(board *b, const uint8_t *g) {
+    memset(b, 0, sizeof(*b));
+    for (int cell = 0; cell < g_geo.cells; cell++) {
+        int v = g[cell];
+        if (0 == v) continue;
+        if (v > g_geo.n || !isValid(v, b, cell)) return 0;
+        placeAt(b, cell, v);
+    }
+    return 1;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Calculates solution of puzzle by assigning starting value startV
+                                and using recursive backtracking algorithm
+ * In arg:      b             Board containing Sudoku problem
+                                cell      Index of the previous element
+                                startV      Starting value from which to find
+                                            legal entries
+                                nTimes      Depth of recursion
+                B             Side of a box
+                self          Specialized instance, for recursion
+ * Return val:  A bool which is true if legal entry found at this location
+ */
+
+KERNEL bool helperKernel(board *b, int cell, int startV, int nTimes,
+                         const int B, helper_fn self)
+{
+    const int n = B * B;
+
+    rdLock(&g_hot.lock);
+
+    if (1 == g_hot.finished) {
+        rwUnlock(&g_hot.lock);
+        traceRecord("cancelled", traceNow(), 0, nTimes);
+        PROBE2(cancel, g_solve_seq, nTimes);
+        return 1;
+    }
+    rwUnlock(&g_hot.lock);
+    t_nodes++;
+
+    // If depth of recursion is n * n, then board solved
+    if (n * n == nTimes) return 1;
+    // Restart budget spent: unwind, restoring the board
+    if (t_nodes >= t_limit) return 0;
+    // Do a loop over the cells, row by row
+    if (++cell == n * n) cell = 0;
+
+
+    if (0 != b->cell[cell]){
+        // recursion
+        return self(b, cell, startV, nTimes+1);
+    }
+
+    if (deadKeeps(b) && deadFind(b)) return 0;
+
+    // Children restore the masks, so the used digits stay fixed here
+    mask_t used = usedAt(b, cell);
+
+    for (int val = 1; val <= n; ++val) {
+        if (++startV == n + 1) {
+            startV = 1;
+        }
+        if (!(used & ((mask_t)1 << startV))) {
+            placeAt(b, cell, startV);
+            PROBE3(branch, nTimes, cell, startV);
+            if (self(b, cell, startV, nTimes+1))
+                return 1;
+            clearAt(b, cell, startV);
+        }
+    }
+    // If no match found then backtrack to previus block
+    if (deadKeeps(b) && t_nodes < t_limit) deadPut(b);
+
+    PROBE2(backtrack, nTimes, cell);
+    return 0;
+} //End of function
+
+/* One copy of the search per box size, B a compile-time constant */
+#define SPECIALIZE_HELPER(B) \
+    bool sudokuHelper##B(board *b, int cell, int startV, int nTimes) \
+    { \
+        return helperKernel(b, cell, startV, nTimes, B, sudokuHelper##B); \
+    }
+
+SPECIALIZE_HELPER(2)
+SPECIALIZE_HELPER(3)
+SPECIALIZE_HELPER(4)
+SPECIALIZE_HELPER(5)
+
+helper_fn const g_helpers[MAXBOX + 1] = {
+    NULL, NULL, sudokuHelper2, sudokuHelper3, sudokuHelper4, sudokuHelper5
+};
+
+/*-------------------------------------------------------------------
+ * Purpose:     Runs the search kernel specialized for the current size
+ * In arg:      see helperKernel
+ * Return val:  A bool which is true if legal entry found at this location
+ */
+bool sudokuHelper(board *b, int cell, int startV, int nTimes) {
+    return g_helpers[g_geo.box](b, cell, startV, nTimes);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Finds the empty cell with the fewest candidates
+ * In arg:      b             Board
+ * Out arg:     cands         Candidates of that cell, 0 if it has none
+ * Return val:  Index of the cell, -1 if the board is full
+ */
+KERNEL int pickCell(const board *b, mask_t *cands) {
+    const mask_t all = (((mask_t)1 << g_geo.n) - 1) << 1;
+    int best = -1, fewest = g_geo.n + 1;
+    *cands = 0;
+    for (int cell = 0; cell < g_geo.cells; cell++) {
+        if (0 != b->cell[cell]) continue;
+        mask_t m = all & ~usedAt(b, cell);
+        int k = __builtin_popcount(m);
+        if (k < fewest) {
+            fewest = k;
+            best = cell;
+            *cands = m;
+            if (k <= 1) break;
+        }
+    }
+    return best;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     pickCell with ties between equally constrained cells
+                broken at random
+ * In arg:      b             Board
+                rng           Generator state
+ * Out arg:     cands         Candidates of that cell, 0 if it has none
+ * Return val:  Index of the cell, -1 if the board is full
+ */
+int pickCellRandom(const board *b, mask_t *cands, uint64_t *rng) {
+    const mask_t all = (((mask_t)1 << g_geo.n) - 1) << 1;
+    int best = -1, fewest = g_geo.n + 1, ties = 0;
+    *cands = 0;
+    for (int cell = 0; cell < g_geo.cells; cell++) {
+        if (0 != b->cell[cell]) continue;
+        mask_t m = all & ~usedAt(b, cell);
+        int k = __builtin_popcount(m);
+        if (0 == k) {
+            *cands = 0;
+            return cell;
+        }
+        if (k < fewest) ties = 0;
+        // Reservoir sampling keeps each of the ties with equal chance
+        if (k <= fewest && 0 == rngNext(rng) % ++ties) {
+            fewest = k;
+            best = cell;
+            *cands = m;
+        }
+    }
+    return best;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Counts the solutions below a board, expanding the most
+                constrained cell first, until g_hot.found reaches cap.
+                The first solution found by any worker is kept in g_first
+ * In arg:      b             Board, restored on return
+                cap           Count at which every worker stops
+ */
+void countKernel(board *b, uint64_t cap) {
+    t_nodes++;
+    if (__atomic_load_n(&g_hot.found, __ATOMIC_RELAXED) >= cap) return;
+
+    mask_t cands;
+    int cell = pickCell(b, &cands);
+    if (cell < 0) {
+        if (0 == __atomic_fetch_add(&g_hot.found, 1, __ATOMIC_RELAXED)) {
+            g_first = *b;
+        }
+        return;
+    }
+    while (cands) {
+        int v = __builtin_ctz(cands);
+        cands &= cands - 1;
+        placeAt(b, cell, v);
+        PROBE3(branch, 0, cell, v);
+        countKernel(b, cap);
+        clearAt(b, cell, v);
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Empties a frontier, allocating its ring from the calling
+                thread's arena
+ * In arg:      cap           Subproblems the ring holds
+ * Out arg:     f             Frontier
+ */
+void frontierInit(frontier *f, int cap) {
+    f->cap = cap;
+    f->node = arenaAlloc(t_arena, f->cap * sizeof(board), CACHELINE);
+    f->head = 0;
+    f->count = 0;
+    f->next = 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Appends a subproblem to a frontier with room for it
+ * In arg:      b             Board of the subproblem
+ * Out arg:     f             Frontier
+ */
+void frontierPush(frontier *f, const board *b) {
+    f->node[(f->head + f->count++) % f->cap] = *b;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Splits the subproblems of a frontier breadth first until
+                there are at least target, or fewer if the trees are
+                smaller. Forced cells are filled on the way, dead
+                branches dropped and full boards kept as they are
+ * In arg:      f             Frontier with room for target + MAXN
+                target        Subproblems wanted
+ * Out arg:     f             Split frontier
+ */
+void frontierExpand(frontier *f, int target) {
+    // Expand the oldest subproblem until enough exist or all are full
+    for (int idle = 0; f->count > 0 && f->count < target
+                       && idle < f->count; ) {
+        board b = f->node[f->head];
+        if (++f->head == f->cap) f->head = 0;
+        f->count--;
+
+        mask_t cands;
+        int cell = pickCell(&b, &cands);
+        if (cell < 0) {
+            f->node[(f->head + f->count++) % f->cap] = b;
+            idle++;
+            continue;
+        }
+        idle = 0;
+        while (cands) {
+            int v = __builtin_ctz(cands);
+            cands &= cands - 1;
+            board *child = &f->node[(f->head + f->count++) % f->cap];
+            *child = b;
+            placeAt(child, cell, v);
+        }
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Splits the search tree of a board into at least target
+                disjoint subproblems, see frontierExpand
+ * In arg:      root          Board to split
+                target        Subproblems wanted
+ * Out arg:     f             Frontier, allocated from the calling
+                              thread's arena
+ */
+void frontierSplit(frontier *f, const board *root, int target) {
+    frontierInit(f, target + MAXN);
+    frontierPush(f, root);
+    frontierExpand(f, target);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Claims the next unexplored subproblem of a frontier
+ * In arg:      f         Frontier shared by the workers
+ * Return val:  Index of the subproblem, -1 once all are claimed
+ */
+int frontierClaim(frontier *f) {
+    int i = __atomic_fetch_add(&f->next, 1, __ATOMIC_RELAXED);
+    return i < f->count ? i : -1;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Looks up a subproblem of a frontier
+ * In arg:      f         Frontier
+                i         Index of the subproblem, below f->count
+ * Return val:  Board of the subproblem
+ */
+board *frontierAt(frontier *f, int i) {
+    return &f->node[(f->head + i) % f->cap];
+}
+
+
+
+
+
+
+/*-------------------------------------------------------------------
+ * Purpose:     Tells a portfolio search whether to unwind: another
+                worker has finished, or its restart budget is spent
+ * Return val:  A bool which is true if the search should stop
+ */
+KERNEL bool searchStop(void) {
+    return __atomic_load_n(&g_hot.finished, __ATOMIC_RELAXED)
+           || ++t_nodes >= t_limit;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Backtracking on the most constrained cell first
+ * In arg:      b         Board, solved on success, else restored
+                down      Try digits from high to low
+                rng       Try digits in random order instead, or NULL
+ * Return val:  A bool which is true if the board was solved; also true
+                once another worker finished, as in helperKernel
+ */
+bool mrvKernel(board *b, bool down, uint64_t *rng) {
+    if (searchStop()) return g_hot.finished;
+    if (deadKeeps(b) && deadFind(b)) return 0;
+
+    mask_t cands;
+    int cell = rng ? pickCellRandom(b, &cands, rng) : pickCell(b, &cands);
+    if (cell < 0) return 1;
+    while (cands) {
+        int v;
+        if (rng) {
+            // k-th set bit for a random k
+            mask_t m = cands;
+            for (int k = rngNext(rng) % __builtin_popcount(m); k > 0; k--) {
+                m &= m - 1;
+            }
+            v = __builtin_ctz(m);
+        } else {
+            v = down ? 31 - __builtin_clz(cands) : __builtin_ctz(cands);
+        }
+        cands &= ~((mask_t)1 << v);
+        placeAt(b, cell, v);
+        PROBE3(branch, 0, cell, v);
+        if (mrvKernel(b, down, rng)) return 1;
+        clearAt(b, cell, v);
+    }
+    // Unless the restart budget cut it short, the subtree is refuted
+    if (deadKeeps(b) && t_nodes < t_limit) deadPut(b);
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Term i of the Luby sequence 1 1 2 1 1 2 4 1 1 2 ...,
+                the restart schedule within a log factor of the best
+                fixed one for any runtime distribution
+ * In arg:      i         Index, 1 based
+ * Return val:  The term, a power of two
+ */
+uint64_t luby(uint64_t i) {
+    for (;;) {
+        uint64_t k = 1;
+        while ((k << 1) - 1 < i) k <<= 1;   // k = 2^(m-1), 2^m - 1 >= i
+        if ((k << 1) - 1 == i) return k;
+        i -= k - 1;
+    }
+}
+
+/* Conflict-directed backjumping over the empty cells of a board, taken
+   in scan order: level i assigns cell order[i]. A digit ruled out at a
+   level is blamed on the level that placed it in a unit of the cell,
+   so a dead end can jump straight back to its latest culprit */
+typedef struct
+{
+    int *order;                 // cell of each level
+    int16_t *holder;            // level that placed digit v in unit u, at
+                                // u * (n + 1) + v; -1 for a clue
+    uint64_t *conf;             // conflict set of each level, words apiece
+    int levels;
+    int words;                  // 64-bit words of a conflict set
+} cbj;
+
+/*-------------------------------------------------------------------
+ * Purpose:     Orders the empty cells of a board for cbjSearch from the
+                calling thread's arena, scanning row by row from the
+                cell after cell as the scan kernel does
+ * In arg:      b         Valid board
+                cell      Cell before the first one scanned
+ * Out arg:     x         Search state, all conflict sets empty
+ */
+void cbjBuild(cbj *x, const board *b, int cell) {
+    const int n = g_geo.n, cells = g_geo.cells;
+    x->order = arenaAlloc(t_arena, cells * sizeof(int), CACHELINE);
+    x->holder = arenaAlloc(t_arena, 3 * n * (n + 1) * sizeof(int16_t),
+                           CACHELINE);
+    x->words = (cells + 63) / 64;
+    x->conf = arenaAlloc(t_arena, cells * x->words * sizeof(uint64_t),
+                         CACHELINE);
+    memset(x->holder, 0xff, 3 * n * (n + 1) * sizeof(int16_t));
+    x->levels = 0;
+    for (int k = 0; k < cells; k++) {
+        if (++cell == cells) cell = 0;
+        if (0 == b->cell[cell]) x->order[x->levels++] = cell;
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Adds the culprit of a digit ruled out at a cell to a
+                conflict set: the earliest level that placed it in one
+                of the cell's units, or none if a clue holds it
+ * In arg:      x         Search state
+                b         Board
+                cell      Cell the digit was ruled out at
+                v         The digit
+ * Out arg:     conf      Conflict set of the cell's level
+ */
+KERNEL void cbjBlame(const cbj *x, const board *b, int cell, int v,
+                     uint64_t *conf) {
+    const int n = g_geo.n;
+    const uint8_t *u = g_geo.unitOf[cell];
+    int culprit = INT16_MAX;
+    for (int j = 0; j < 3; j++) {
+        if (!(b->unit[u[j]] & ((mask_t)1 << v))) continue;
+        int lv = x->holder[u[j] * (n + 1) + v];
+        if (lv < 0) return;
+        if (lv < culprit) culprit = lv;
+    }
+    conf[culprit / 64] |= (uint64_t)1 << (culprit % 64);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Backtracking with conflict-directed backjumping. Each
+                level tries the digits of its cell from the one after
+                startV, as the scan kernel does, and records in its
+                conflict set the levels that ruled digits out. When all
+                fail it hands that set to its latest member and unwinds
+                every level in between without trying their other digits
+ * In arg:      x         Search state
+                b         Board, solved on success, else restored
+                lv        Level to assign
+                startV    Digit before the first one tried
+ * Return val:  x->levels if the board was solved, or once another
+                worker finished as in helperKernel; else the level to
+                resume at, -1 if none is left or the restart budget ran out
+ */
+int cbjSearch(cbj *x, board *b, int lv, int startV) {
+    if (searchStop()) return g_hot.finished ? x->levels : -1;
+    if (lv == x->levels) return lv;
+    if (deadKeeps(b) && deadFind(b)) {
+        // Refuted by some search, for reasons unknown here: every level
+        // above is to blame
+        if (0 == lv) return -1;
+        uint64_t *into = x->conf + (lv - 1) * x->words;
+        for (int w = 0; w * 64 < lv - 1; w++) {
+            into[w] |= lv - 1 - w * 64 >= 64 ? ~(uint64_t)0
+                     : ((uint64_t)1 << (lv - 1 - w * 64)) - 1;
+        }
+        return lv - 1;
+    }
+
+    const int n = g_geo.n, cell = x->order[lv];
+    const uint8_t *u = g_geo.unitOf[cell];
+    uint64_t *conf = x->conf + lv * x->words;
+    memset(conf, 0, x->words * sizeof(uint64_t));
+
+    // Children restore the masks, so the used digits stay fixed here
+    mask_t used = usedAt(b, cell);
+    for (int k = 0; k < n; k++) {
+        if (++startV == n + 1) startV = 1;
+        if (used & ((mask_t)1 << startV)) {
+            cbjBlame(x, b, cell, startV, conf);
+            continue;
+        }
+        placeAt(b, cell, startV);
+        for (int j = 0; j < 3; j++) x->holder[u[j] * (n + 1) + startV] = lv;
+        PROBE3(branch, lv, cell, startV);
+        int r = cbjSearch(x, b, lv + 1, startV);
+        if (r == x->levels) return r;
+        for (int j = 0; j < 3; j++) x->holder[u[j] * (n + 1) + startV] = -1;
+        clearAt(b, cell, startV);
+        if (r < lv) return r;
+    }
+
+    // Dead end: jump to the latest culprit, which inherits the rest
+    if (deadKeeps(b) && t_nodes < t_limit) deadPut(b);
+    PROBE2(backtrack, lv, cell);
+    for (int w = x->words - 1; w >= 0; w--) {
+        if (0 == conf[w]) continue;
+        int to = w * 64 + 63 - __builtin_clzll(conf[w]);
+        conf[w] &= ~((uint64_t)1 << (to % 64));
+        uint64_t *into = x->conf + to * x->words;
+        for (int i = 0; i <= w; i++) into[i] |= conf[i];
+        return to;
+    }
+    return -1;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Scan search with conflict-directed backjumping, see
+                cbjSearch. Its scratch is dropped on return
+ * In arg:      b         Board, solved on success, else restored
+                cell      Cell before the first one scanned
+                startV    Digit before the first one tried
+ * Return val:  See mrvKernel
+ */
+bool cbjKernel(board *b, int cell, int startV) {
+    arena mark = *t_arena;
+    cbj x;
+    cbjBuild(&x, b, cell);
+    bool found = x.levels == cbjSearch(&x, b, 0, startV);
+    *t_arena = mark;
+    return found;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Runs the scan strategy: cbjKernel, or sudokuHelper's
+                chronological backtracking under -j
+ * In arg:      see cbjKernel
+ * Return val:  See mrvKernel
+ */
+bool scanKernel(board *b, int cell, int startV) {
+    return g_backjump ? cbjKernel(b, cell, startV)
+                      : sudokuHelper(b, cell, startV, 0);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Randomized search, rerun from the start whenever its
+                node budget, the unit times the next Luby term, runs
+                out: MRV with fresh random cell ties and digit order, or
+                the scan kernel from a fresh random cell and start
+                digit. Heavy-tailed runtimes then cost a few budgets
+                instead of one unlucky descent
+ * In arg:      b         Board, solved on success
+                scan      Restart the scan kernel instead of MRV
+ * Return val:  See mrvKernel
+ */
+bool restartKernel(board *b, bool scan) {
+    uint64_t unit = scan ? SCAN_RESTART_UNIT : RESTART_UNIT;
+    for (uint64_t i = 1; ; i++) {
+        t_limit = t_nodes + unit * luby(i);
+        bool found = scan ? scanKernel(b, rngNext(&t_rng) % g_geo.cells,
+                                       rngNext(&t_rng) % g_geo.n)
+                          : mrvKernel(b, 0, &t_rng);
+        if (found) return 1;
+        // Unwinding restored b; an exhausted tree is a proof
+        if (t_nodes < t_limit) return 0;
+        statAdd(&t_metrics->restarts, 1);
+    }
+}
+
+/* Exact cover matrix of the puzzle for Dancing Links: node 0 is the
+   root, 1..cols the column headers, then 4 nodes per candidate row */
+typedef struct
+{
+    int *L, *R, *U, *D, *C;     // links and column of every node
+    int *size;                  // nodes left in each column
+    int *cand;                  // cell * n + digit - 1 of each node's row
+} dlx;
+
+/*-------------------------------------------------------------------
+ * Purpose:     Unlinks a column and every row that meets it, or links
+                them back in the reverse order
+ * In arg:      x         Matrix
+                c         Column header
+ */
+void dlxCover(dlx *x, int c) {
+    x->R[x->L[c]] = x->R[c];
+    x->L[x->R[c]] = x->L[c];
+    for (int i = x->D[c]; i != c; i = x->D[i]) {
+        for (int j = x->R[i]; j != i; j = x->R[j]) {
+            x->D[x->U[j]] = x->D[j];
+            x->U[x->D[j]] = x->U[j];
+            x->size[x->C[j]]--;
+        }
+    }
+}
+
+void dlxUncover(dlx *x, int c) {
+    for (int i = x->U[c]; i != c; i = x->U[i]) {
+        for (int j = x->L[i]; j != i; j = x->L[j]) {
+            x->size[x->C[j]]++;
+            x->D[x->U[j]] = j;
+            x->U[x->D[j]] = j;
+        }
+    }
+    x->R[x->L[c]] = c;
+    x->L[x->R[c]] = c;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Builds the exact cover matrix of a board from the
+                calling thread's arena, with the rows of its clues
+                already chosen. Columns: cell filled, digit in row,
+                digit in column, digit in box
+ * In arg:      b         Valid board
+ * Out arg:     x         Matrix
+ */
+void dlxBuild(dlx *x, const board *b) {
+    const int n = g_geo.n, cols = 4 * g_geo.cells;
+    const int nodes = 1 + cols + 4 * g_geo.cells * n;
+    int *mem = arenaAlloc(t_arena, 7 * nodes * sizeof(int), CACHELINE);
+    x->L = mem;
+    x->R = mem + nodes;
+    x->U = mem + 2 * nodes;
+    x->D = mem + 3 * nodes;
+    x->C = mem + 4 * nodes;
+    x->size = mem + 5 * nodes;
+    x->cand = mem + 6 * nodes;
+    for (int c = 0; c <= cols; c++) {
+        x->L[c] = c ? c - 1 : cols;
+        x->R[c] = c < cols ? c + 1 : 0;
+        x->U[c] = x->D[c] = x->C[c] = c;
+        x->size[c] = 0;
+    }
+
+    int at = cols + 1;
+    for (int cell = 0; cell < g_geo.cells; cell++) {
+        const int r = cell / n, k = cell % n, bx = g_geo.boxOf[cell];
+        for (int v = 1; v <= n; v++) {
+            const int col[4] = { 1 + cell, 1 + g_geo.cells + r * n + v - 1,
+                                 1 + 2 * g_geo.cells + k * n + v - 1,
+                                 1 + 3 * g_geo.cells + bx * n + v - 1 };
+            for (int j = 0; j < 4; j++) {
+                int node = at + j, c = col[j];
+                x->L[node] = at + (j + 3) % 4;
+                x->R[node] = at + (j + 1) % 4;
+                x->U[node] = x->U[c];
+                x->D[node] = c;
+                x->D[x->U[c]] = node;
+                x->U[c] = node;
+                x->C[node] = c;
+                x->cand[node] = cell * n + v - 1;
+                x->size[c]++;
+            }
+            at += 4;
+        }
+    }
+
+    // A clue's row is chosen by covering its four columns
+    for (int cell = 0; cell < g_geo.cells; cell++) {
+        int v = b->cell[cell];
+        if (0 == v) continue;
+        int node = cols + 1 + 4 * (cell * n + v - 1);
+        for (int j = 0; j < 4; j++) dlxCover(x, x->C[node + j]);
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Algorithm X on the Dancing Links matrix, branching on
+                the column with the fewest rows
+ * In arg:      x         Matrix, restored unless solved
+                b         Board the chosen rows are placed on
+ * Return val:  See mrvKernel
+ */
+bool dlxSearch(dlx *x, board *b) {
+    if (searchStop()) return g_hot.finished;
+    if (0 == x->R[0]) return 1;
+    if (deadKeeps(b) && deadFind(b)) return 0;
+
+    int c = x->R[0];
+    for (int j = x->R[c]; j != 0 && x->size[c] > 1; j = x->R[j]) {
+        if (x->size[j] < x->size[c]) c = j;
+    }
+    if (0 == x->size[c]) return 0;
+
+    const int n = g_geo.n;
+    dlxCover(x, c);
+    for (int r = x->D[c]; r != c; r = x->D[r]) {
+        for (int j = x->R[r]; j != r; j = x->R[j]) dlxCover(x, x->C[j]);
+        int cell = x->cand[r] / n, v = x->cand[r] % n + 1;
+        placeAt(b, cell, v);
+        PROBE3(branch, 0, cell, v);
+        if (dlxSearch(x, b)) return 1;
+        clearAt(b, cell, v);
+        for (int j = x->L[r]; j != r; j = x->L[j]) dlxUncover(x, x->C[j]);
+    }
+    dlxUncover(x, c);
+    if (deadKeeps(b) && t_nodes < t_limit) deadPut(b);
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Branches on the most constrained cell, putting up to
+                LANES of its digits in the lanes of one vector search
+                and propagating them together with lockstepPropagate.
+                Lanes left alive are searched in turn, one depth deeper
+ * In arg:      plane     Candidate planes of every depth, allocated from
+                          the calling thread's arena on first use
+                single    Scratch for lockstepPropagate
+                depth     Depth of this node
+                g         Candidates of the node, in lane lane
+ * Out arg:     b         Solution, when found
+ * Return val:  See mrvKernel
+ */
+bool simdSearch(lanes_t **plane, lanes_t *single, int depth,
+                const lanes_t *g, int lane, board *b) {
+    if (searchStop()) return g_hot.finished;
+
+    int cell = -1, fewest = g_geo.n + 1;
+    for (int c = 0; c < g_geo.cells; c++) {
+        int k = __builtin_popcount(g[c][lane]);
+        if (k > 1 && k < fewest) {
+            fewest = k;
+            cell = c;
+        }
+    }
+    if (cell < 0) {
+        // Every cell single and no contradiction: a solution
+        memset(b, 0, sizeof(*b));
+        for (int c = 0; c < g_geo.cells; c++) {
+            placeAt(b, c, __builtin_ctz(g[c][lane]));
+        }
+        return 1;
+    }
+
+    if (NULL == plane[depth]) {
+        plane[depth] = arenaAlloc(t_arena, g_geo.cells * sizeof(lanes_t),
+                                  CACHELINE);
+    }
+    lanes_t *p = plane[depth];
+    for (mask_t cands = g[cell][lane]; cands; ) {
+        for (int c = 0; c < g_geo.cells; c++) {
+            p[c] = (lanes_t){ 0 } + g[c][lane];
+        }
+        int used = 0;
+        for (; used < LANES; used++) {
+            mask_t v = cands & -cands;
+            p[cell][used] = v;   // 0 once cands is empty: a dead lane
+            cands &= cands - 1;
+        }
+        lanes_t dead;
+        lockstepPropagate(p, single, &dead, g_prop_level);
+        for (int l = 0; l < LANES; l++) {
+            if (dead[l]) continue;
+            if (simdSearch(plane, single, depth + 1, p, l, b)) return 1;
+        }
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Sets up and runs the vector search on a board
+ * In arg:      b         Valid board, replaced by the solution if found
+ * Return val:  See mrvKernel
+ */
+bool simdKernel(board *b) {
+    const mask_t all = (((mask_t)1 << g_geo.n) - 1) << 1;
+    lanes_t **plane = arenaAlloc(t_arena, (g_geo.cells + 1) * sizeof(*plane),
+                                 CACHELINE);
+    lanes_t *root = arenaAlloc(t_arena, g_geo.cells * sizeof(lanes_t),
+                               CACHELINE);
+    lanes_t *single = arenaAlloc(t_arena, g_geo.cells * sizeof(lanes_t),
+                                 CACHELINE);
+    memset(plane, 0, (g_geo.cells + 1) * sizeof(*plane));
+    for (int c = 0; c < g_geo.cells; c++) {
+        root[c] = (lanes_t){ 0 };
+        root[c][0] = b->cell[c] ? (mask_t)1 << b->cell[c]
+                                : all & ~usedAt(b, c);
+    }
+    lanes_t dead;
+    lockstepPropagate(root, single, &dead, g_prop_level);
+    if (dead[0]) return 0;
+    board sol;
+    if (!simdSearch(plane, single, 0, root, 0, &sol)) return 0;
+    if (!g_hot.finished) *b = sol;
+    return 1;
+}
+
+/* CDCL solver over the one-hot encoding of a board: variable
+   cell * n + digit - 1 is true when the cell holds the digit, literal
+   2v is v and 2v + 1 its negation. Every variable sits in four
+   exactly-one groups: its cell, and its digit in its row, column and
+   box. Their at-least-one halves are clauses in the arena; the
+   at-most-one halves are never expanded into pairwise clauses but
+   propagated straight from g_geo, with the true variable as reason.
+   Clauses watching a literal are chained through their headers, so
+   nothing but the arena grows during a search */
+typedef struct
+{
+    uint32_t *mem;              // clauses, SAT_HDR words then literals
+    uint32_t top, cap;          // words used and available
+    uint32_t *watch;            // first clause watching each literal
+    int8_t *val;                // 1 true, -1 false, 0 open, per literal
+    int8_t *phase;              // value a variable was last given
+    uint8_t *seen;              // variables met by satAnalyze
+    int *level;                 // decision level of each variable
+    uint32_t *reason;           // clause, SAT_AMO | true literal or SAT_NIL
+    int *trail;                 // literals in assignment order
+    int *lim;                   // trail size before each decision
+    int head, size, levels;     // propagation queue, trail size, decisions
+    double *act, inc;           // VSIDS activity and current bump
+    int *heap, *pos, heapN;     // open variables by activity, -1 if out
+    uint32_t *buf;              // clause being learnt
+    uint32_t amo[2];            // clause of an at-most-one conflict
+    uint64_t *stamp;            // per level, for the LBD of learnt clauses
+    uint64_t conflicts;
+    int learnt, maxLearnt;      // learnt clauses, and before a reduction
+    int vars;
+} sat;
+
+/*-------------------------------------------------------------------
+ * Purpose:     Makes a literal true at the current decision level
+ * In arg:      s         Solver
+                lit       Open literal
+                why       Its reason, see sat
+ */
+KERNEL void satAssign(sat *s, int lit, uint32_t why) {
+    s->val[lit] = 1;
+    s->val[lit ^ 1] = -1;
+    s->level[lit >> 1] = s->levels;
+    s->reason[lit >> 1] = why;
+    s->trail[s->size++] = lit;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Restores the heap order above or below a slot, or adds
+                an open variable to the heap
+ * In arg:      s         Solver
+                i         Slot of the heap
+ */
+void satHeapUp(sat *s, int i) {
+    int v = s->heap[i];
+    while (i > 0 && s->act[s->heap[(i - 1) / 2]] < s->act[v]) {
+        s->heap[i] = s->heap[(i - 1) / 2];
+        s->pos[s->heap[i]] = i;
+        i = (i - 1) / 2;
+    }
+    s->heap[i] = v;
+    s->pos[v] = i;
+}
+
+void satHeapDown(sat *s, int i) {
+    int v = s->heap[i];
+    for (int k; (k = 2 * i + 1) < s->heapN; i = k) {
+        if (k + 1 < s->heapN && s->act[s->heap[k + 1]] > s->act[s->heap[k]]) k++;
+        if (s->act[s->heap[k]] <= s->act[v]) break;
+        s->heap[i] = s->heap[k];
+        s->pos[s->heap[i]] = i;
+    }
+    s->heap[i] = v;
+    s->pos[v] = i;
+}
+
+void satHeapInsert(sat *s, int v) {
+    if (s->pos[v] >= 0) return;
+    s->heap[s->heapN] = v;
+    satHeapUp(s, s->heapN++);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Takes the most active open variable off the heap
+ * In arg:      s         Solver
+ * Return val:  The variable, -1 once every variable is assigned
+ */
+int satDecide(sat *s) {
+    while (s->heapN > 0) {
+        int v = s->heap[0];
+        s->pos[v] = -1;
+        if (--s->heapN > 0) {
+            s->heap[0] = s->heap[s->heapN];
+            satHeapDown(s, 0);
+        }
+        if (0 == s->val[2 * v]) return v;
+    }
+    return -1;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Bumps the VSIDS activity of a variable met in a conflict,
+                rescaling every activity before they overflow
+ * In arg:      s         Solver
+                v         Variable
+ */
+void satBump(sat *s, int v) {
+    if ((s->act[v] += s->inc) > 1e100) {
+        for (int i = 0; i < s->vars; i++) s->act[i] *= 1e-100;
+        s->inc *= 1e-100;
+    }
+    if (s->pos[v] >= 0) satHeapUp(s, s->pos[v]);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Adds a clause to the arena and watches its first two
+                literals, which must not be false
+ * In arg:      s         Solver
+                lits      Literals
+                len       At least 2
+                lbd       Distinct decision levels of a learnt clause,
+                          0 for a clause of the puzzle
+ * Return val:  The clause, SAT_NIL if the arena is full
+ */
+uint32_t satAdd(sat *s, const uint32_t *lits, int len, int lbd) {
+    if (s->top + SAT_HDR + len > s->cap) return SAT_NIL;
+    uint32_t c = s->top, *cl = s->mem + c;
+    s->top += SAT_HDR + len;
+    cl[0] = len;
+    cl[1] = lbd ? SAT_LEARNT | lbd : 0;
+    memcpy(cl + SAT_HDR, lits, len * sizeof(uint32_t));
+    for (int j = 0; j < 2; j++) {
+        cl[2 + j] = s->watch[lits[j]];
+        s->watch[lits[j]] = c;
+    }
+    s->learnt += lbd > 0;
+    return c;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Makes a variable of an at-most-one group false because
+                another one, p, is true
+ * In arg:      s         Solver
+                p         True positive literal
+                q         Positive literal of the same group
+ * Return val:  A bool which is true if q was true already, the conflict
+                then left in s->amo
+ */
+KERNEL bool satAmo(sat *s, int p, int q) {
+    if (s->val[q] > 0) {
+        s->amo[0] = p ^ 1;
+        s->amo[1] = q ^ 1;
+        return 1;
+    }
+    if (0 == s->val[q]) satAssign(s, q ^ 1, SAT_AMO | p);
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Unit propagation of the trail: at-most-one groups of
+                every true variable, then the clauses watching each
+                literal that became false. Their implied literal is
+                kept first, where satAnalyze looks for it
+ * In arg:      s         Solver
+ * Return val:  The conflicting clause, SAT_AMO for an at-most-one
+                conflict, or SAT_NIL
+ */
+uint32_t satPropagate(sat *s) {
+    const int n = g_geo.n;
+    while (s->head < s->size) {
+        int p = s->trail[s->head++];
+        if (!(p & 1)) {
+            const int cell = (p >> 1) / n, d = (p >> 1) % n;
+            for (int k = 0; k < n; k++) {
+                if (k != d && satAmo(s, p, 2 * (cell * n + k))) return SAT_AMO;
+            }
+            for (int j = 0; j < 3; j++) {
+                const uint16_t *cells = &g_geo.unitCells[g_geo.unitOf[cell][j] * n];
+                for (int k = 0; k < n; k++) {
+                    if (cells[k] != cell && satAmo(s, p, 2 * (cells[k] * n + d))) {
+                        return SAT_AMO;
+                    }
+                }
+            }
+        }
+
+        const uint32_t f = p ^ 1;
+        uint32_t *prev = &s->watch[f];
+        for (uint32_t c = *prev, next; c != SAT_NIL; c = next) {
+            uint32_t *cl = s->mem + c, *lit = cl + SAT_HDR, t;
+            if (lit[0] == f) {
+                t = lit[0]; lit[0] = lit[1]; lit[1] = t;
+                t = cl[2]; cl[2] = cl[3]; cl[3] = t;
+            }
+            next = cl[3];
+            if (s->val[lit[0]] > 0) {
+                prev = &cl[3];
+                continue;
+            }
+            uint32_t k = 2;
+            while (k < cl[0] && s->val[lit[k]] < 0) k++;
+            if (k < cl[0]) {
+                // Watch lit[k] instead
+                t = lit[1]; lit[1] = lit[k]; lit[k] = t;
+                *prev = next;
+                cl[3] = s->watch[lit[1]];
+                s->watch[lit[1]] = c;
+            } else if (s->val[lit[0]] < 0) {
+                return c;
+            } else {
+                satAssign(s, lit[0], c);
+                prev = &cl[3];
+            }
+        }
+    }
+    return SAT_NIL;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Undoes the assignments above a decision level, saving
+                their phases and returning their variables to the heap
+ * In arg:      s         Solver
+                level     Level to keep
+ */
+void satBacktrack(sat *s, int level) {
+    if (s->levels <= level) return;
+    for (int i = s->size - 1; i >= s->lim[level]; i--) {
+        int v = s->trail[i] >> 1;
+        s->phase[v] = s->val[2 * v];
+        s->val[2 * v] = s->val[2 * v + 1] = 0;
+        satHeapInsert(s, v);
+    }
+    s->size = s->head = s->lim[level];
+    s->levels = level;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Learns the first-UIP clause of a conflict into s->buf,
+                asserting literal first and a literal of the level to
+                jump to second, after dropping literals whose reason
+                the rest of the clause already implies
+ * In arg:      s         Solver
+                conflict  Return value of satPropagate
+ * Out arg:     len       Literals of the clause
+                lbd       Distinct decision levels among them
+ * Return val:  The decision level to jump back to
+ */
+int satAnalyze(sat *s, uint32_t conflict, int *len, int *lbd) {
+    const uint32_t *lits = SAT_AMO == conflict ? s->amo
+                                               : s->mem + conflict + SAT_HDR;
+    int cnt = SAT_AMO == conflict ? 2 : (int)s->mem[conflict];
+    int n = 1, path = 0, i = s->size - 1, p;
+    uint32_t other;
+    for (;;) {
+        for (int k = 0; k < cnt; k++) {
+            int v = lits[k] >> 1;
+            if (s->seen[v] || 0 == s->level[v]) continue;
+            s->seen[v] = 1;
+            satBump(s, v);
+            if (s->level[v] == s->levels) path++;
+            else s->buf[n++] = lits[k];
+        }
+        while (!s->seen[s->trail[i] >> 1]) i--;
+        p = s->trail[i--];
+        s->seen[p >> 1] = 0;
+        if (0 == --path) break;
+        // The reason of p, without p itself
+        uint32_t r = s->reason[p >> 1];
+        if (r & SAT_AMO) {
+            other = (r & ~SAT_AMO) ^ 1;
+            lits = &other;
+            cnt = 1;
+        } else {
+            lits = s->mem + r + SAT_HDR + 1;
+            cnt = s->mem[r] - 1;
+        }
+    }
+    s->buf[0] = p ^ 1;
+
+    int m = 1, back = 0;
+    for (int k = 1; k < n; k++) {
+        int v = s->buf[k] >> 1;
+        uint32_t r = s->reason[v];
+        bool keep = SAT_NIL == r;
+        if (!keep && (r & SAT_AMO)) {
+            int u = (r & ~SAT_AMO) >> 1;
+            keep = !s->seen[u] && s->level[u] > 0;
+        } else if (!keep) {
+            for (uint32_t j = 1; j < s->mem[r] && !keep; j++) {
+                int u = s->mem[r + SAT_HDR + j] >> 1;
+                keep = !s->seen[u] && s->level[u] > 0;
+            }
+        }
+        if (!keep) {
+            s->seen[v] = 0;
+            continue;
+        }
+        s->buf[m] = s->buf[k];
+        if (s->level[v] > s->level[s->buf[1] >> 1] || 1 == m) {
+            uint32_t t = s->buf[1]; s->buf[1] = s->buf[m]; s->buf[m] = t;
+        }
+        m++;
+    }
+    s->conflicts++;
+    *lbd = 1;
+    for (int k = 1; k < m; k++) {
+        int v = s->buf[k] >> 1;
+        s->seen[v] = 0;
+        if (s->stamp[s->level[v]] != s->conflicts) {
+            s->stamp[s->level[v]] = s->conflicts;
+            ++*lbd;
+        }
+    }
+    if (m > 1) back = s->level[s->buf[1] >> 1];
+    *len = m;
+    return back;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     qsort order of satReduce keys: higher LBD first, older
+                clauses first among equals
+ */
+int satKeyCmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Deletes the worse half of the learnt clauses with an LBD
+                above 2, compacts the arena and rebuilds the watch
+                chains. Only runs at level 0, where reasons are not
+                followed any more
+ * In arg:      s         Solver
+ */
+void satReduce(sat *s) {
+    arena mark = *t_arena;
+    uint64_t *key = arenaAlloc(t_arena, (s->learnt + 1) * sizeof(uint64_t),
+                               sizeof(uint64_t));
+    int k = 0;
+    for (uint32_t c = 0; c < s->top; c += SAT_HDR + s->mem[c]) {
+        uint32_t lbd = s->mem[c + 1] & ~SAT_LEARNT;
+        if ((s->mem[c + 1] & SAT_LEARNT) && lbd > 2) {
+            key[k++] = (uint64_t)lbd << 32 | (UINT32_MAX - c);
+        }
+    }
+    qsort(key, k, sizeof(uint64_t), satKeyCmp);
+    for (int i = 0; i < k / 2; i++) {
+        s->mem[UINT32_MAX - (uint32_t)key[i] + 1] |= SAT_DEAD; // word 1
+    }
+    s->learnt -= k / 2;
+    *t_arena = mark;
+
+    uint32_t to = 0;
+    for (uint32_t c = 0, len; c < s->top; c += len) {
+        len = SAT_HDR + s->mem[c];
+        if (s->mem[c + 1] & SAT_DEAD) continue;
+        memmove(s->mem + to, s->mem + c, len * sizeof(uint32_t));
+        to += len;
+    }
+    s->top = to;
+    memset(s->watch, 0xff, 2 * s->vars * sizeof(uint32_t));
+    for (uint32_t c = 0; c < s->top; c += SAT_HDR + s->mem[c]) {
+        for (int j = 0; j < 2; j++) {
+            uint32_t lit = s->mem[c + SAT_HDR + j];
+            s->mem[c + 2 + j] = s->watch[lit];
+            s->watch[lit] = c;
+        }
+    }
+    for (int i = 0; i < s->size; i++) s->reason[s->trail[i] >> 1] = SAT_NIL;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Sets up the solver for a board from the calling thread's
+                arena: clues and what they imply at level 0, then one
+                clause per at-least-one group not yet satisfied, over
+                its literals not yet false
+ * In arg:      b         Valid board
+ * Out arg:     s         Solver
+ * Return val:  A bool which is false if level 0 is already a conflict
+ */
+bool satBuild(sat *s, const board *b) {
+    const int n = g_geo.n, cells = g_geo.cells, vars = cells * n;
+    s->vars = vars;
+    s->cap = 4 * cells * (SAT_HDR + n) + SAT_LEARNT_WORDS;
+    s->mem = arenaAlloc(t_arena, s->cap * sizeof(uint32_t), CACHELINE);
+    s->watch = arenaAlloc(t_arena, 2 * vars * sizeof(uint32_t), CACHELINE);
+    s->val = arenaAlloc(t_arena, 2 * vars, CACHELINE);
+    s->phase = arenaAlloc(t_arena, vars, CACHELINE);
+    s->seen = arenaAlloc(t_arena, vars, CACHELINE);
+    s->level = arenaAlloc(t_arena, vars * sizeof(int), CACHELINE);
+    s->reason = arenaAlloc(t_arena, vars * sizeof(uint32_t), CACHELINE);
+    s->trail = arenaAlloc(t_arena, vars * sizeof(int), CACHELINE);
+    s->lim = arenaAlloc(t_arena, (vars + 1) * sizeof(int), CACHELINE);
+    s->act = arenaAlloc(t_arena, vars * sizeof(double), CACHELINE);
+    s->heap = arenaAlloc(t_arena, vars * sizeof(int), CACHELINE);
+    s->pos = arenaAlloc(t_arena, vars * sizeof(int), CACHELINE);
+    s->buf = arenaAlloc(t_arena, (vars + 1) * sizeof(uint32_t), CACHELINE);
+    s->stamp = arenaAlloc(t_arena, (vars + 1) * sizeof(uint64_t), CACHELINE);
+    memset(s->watch, 0xff, 2 * vars * sizeof(uint32_t));
+    memset(s->val, 0, 2 * vars);
+    memset(s->phase, 1, vars);      // a digit is tried before ruled out
+    memset(s->seen, 0, vars);
+    memset(s->pos, 0xff, vars * sizeof(int));
+    memset(s->stamp, 0, (vars + 1) * sizeof(uint64_t));
+    for (int v = 0; v < vars; v++) s->act[v] = 0;
+    s->inc = 1;
+    s->top = s->head = s->size = s->levels = s->heapN = 0;
+    s->conflicts = 0;
+    s->learnt = 0;
+    s->maxLearnt = SAT_LEARNT_FIRST;
+
+    for (int cell = 0; cell < cells; cell++) {
+        if (0 == b->cell[cell]) continue;
+        int lit = 2 * (cell * n + b->cell[cell] - 1);
+        if (s->val[lit] < 0) return 0;
+        if (0 == s->val[lit]) satAssign(s, lit, SAT_NIL);
+    }
+    if (SAT_NIL != satPropagate(s)) return 0;
+
+    // Groups: the digits of each cell, then the cells of each unit
+    for (int g = 0; g < cells + 3 * n * n; g++) {
+        int len = 0;
+        bool done = 0;
+        for (int k = 0; k < n && !done; k++) {
+            int v = g < cells ? g * n + k
+                  : g_geo.unitCells[(g - cells) / n * n + k] * n + (g - cells) % n;
+            done = s->val[2 * v] > 0;
+            if (0 == s->val[2 * v]) s->buf[len++] = 2 * v;
+        }
+        if (done) continue;
+        if (0 == len) return 0;
+        if (1 == len) satAssign(s, s->buf[0], SAT_NIL);
+        else satAdd(s, s->buf, len, 0);
+    }
+    if (SAT_NIL != satPropagate(s)) return 0;
+    for (int v = 0; v < vars; v++) {
+        if (0 == s->val[2 * v]) satHeapInsert(s, v);
+    }
+    return 1;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Solves a board with CDCL: VSIDS decisions with saved
+                phases, first-UIP learning, restarts every
+                SAT_RESTART_UNIT times the next Luby term conflicts and,
+                at restarts, learnt clause reduction once there are
+                more than allowed
+ * In arg:      b         Board, solved on success
+ * Return val:  See mrvKernel
+ */
+bool satKernel(board *b) {
+    sat s;
+    if (!satBuild(&s, b)) return 0;
+    uint64_t restarts = 1, due = SAT_RESTART_UNIT;
+    for (;;) {
+        uint32_t c = satPropagate(&s);
+        if (SAT_NIL != c) {
+            if (0 == s.levels) return 0;
+            int len, lbd;
+            satBacktrack(&s, satAnalyze(&s, c, &len, &lbd));
+            if (1 == len) {
+                satAssign(&s, s.buf[0], SAT_NIL);
+            } else if (SAT_NIL != (c = satAdd(&s, s.buf, len, lbd))) {
+                satAssign(&s, s.buf[0], c);
+            } else {
+                // Arena full: make room at level 0, where the clause
+                // is open and needs no assertion
+                satBacktrack(&s, 0);
+                satReduce(&s);
+                satAdd(&s, s.buf, len, lbd);
+            }
+            s.inc *= 1 / SAT_DECAY;
+            continue;
+        }
+        if (s.conflicts >= due) {
+            satBacktrack(&s, 0);
+            if (s.learnt > s.maxLearnt) {
+                satReduce(&s);
+                s.maxLearnt += s.maxLearnt / 10;
+            }
+            due = s.conflicts + SAT_RESTART_UNIT * luby(++restarts);
+        }
+        if (searchStop()) return g_hot.finished;
+
+        int v = satDecide(&s);
+        if (v < 0) break;
+        s.lim[s.levels++] = s.size;
+        satAssign(&s, 2 * v + (s.phase[v] < 0), SAT_NIL);
+    }
+
+    for (int cell = 0; cell < g_geo.cells; cell++) {
+        for (int d = 0; 0 == b->cell[cell] && d < g_geo.n; d++) {
+            if (s.val[2 * (cell * g_geo.n + d)] > 0) placeAt(b, cell, d + 1);
+        }
+    }
+    return 1;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Runs the search of a worker's portfolio strategy
+ * In arg:      data      Worker; its board is solved on success
+ * Return val:  See mrvKernel
+ */
+bool portfolioSearch(boardz *data) {
+    t_limit = UINT64_MAX;
+    switch (data->strategy) {
+    case STRAT_MRV:
+        return mrvKernel(&data->board, 0, NULL);
+    case STRAT_MRV_REV:
+        return mrvKernel(&data->board, 1, NULL);
+    case STRAT_RESTART:
+    case STRAT_SCAN_RESTART:
+        return restartKernel(&data->board,
+                             STRAT_SCAN_RESTART == data->strategy);
+    case STRAT_DLX: {
+        dlx x;
+        dlxBuild(&x, &data->board);
+        return dlxSearch(&x, &data->board);
+    }
+    case STRAT_SIMD:
+        return simdKernel(&data->board);
+    case STRAT_SAT:
+        return satKernel(&data->board);
+    default:
+        return scanKernel(&data->board, data->cell, data->start);
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Parses the -p list into g_portfolio
+ * In arg:      arg       Comma separated g_strat_names, or "all"
+ * Return val:  A bool which is false if a name is unknown or the list
+                is longer than PORTFOLIO_MAX
+ */
+bool portfolioParse(const char *arg) {
+    if (0 == strcmp(arg, "all")) {
+        arg = "mrv,dlx,simd,sat,restart,scan-restart,mrv-rev,scan";
+    }
+    g_portfolio.len = 0;
+    while (*arg) {
+        size_t len = strcspn(arg, ",");
+        int k = 0;
+        while (k < STRAT_COUNT && (strlen(g_strat_names[k]) != len
+                                || 0 != strncmp(arg, g_strat_names[k], len))) {
+            k++;
+        }
+        if (STRAT_COUNT == k || PORTFOLIO_MAX == g_portfolio.len) return 0;
+        g_portfolio.list[g_portfolio.len++] = k;
+        arg += len + (',' == arg[len]);
+    }
+    return g_portfolio.len > 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     MRV backtracking that stops after t_limit nodes and then
+                leaves what it has not explored in a frontier: the node
+                it stopped at and the untried digits of every node on
+                the path to it, deepest first
+ * In arg:      b         Board, solved on success, else restored
+                f         Frontier with room for g_geo.cells * g_geo.n
+ * Return val:  1 if solved, 0 if the tree has no solution, -1 if the
+                budget ran out
+ */
+int serialKernel(board *b, frontier *f) {
+    if (++t_nodes >= t_limit) {
+        frontierPush(f, b);
+        return -1;
+    }
+    mask_t cands;
+    int cell = pickCell(b, &cands);
+    if (cell < 0) return 1;
+    while (cands) {
+        int v = __builtin_ctz(cands);
+        cands &= cands - 1;
+        placeAt(b, cell, v);
+        int r = serialKernel(b, f);
+        if (r > 0) return 1;
+        clearAt(b, cell, v);
+        if (r < 0) {
+            for (; cands; cands &= cands - 1) {
+                placeAt(b, cell, __builtin_ctz(cands));
+                frontierPush(f, b);
+                clearAt(b, cell, __builtin_ctz(cands));
+            }
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Measures a puzzle for the hardness model: clues, then
+                naked and hidden singles propagation (lockstepPropagate
+                on one lane, no higher tier: the model was fit on
+                singles) and a histogram of what it leaves open
+ * In arg:      b         Valid board
+ * Out arg:     f         Features; hist[0] counts the bivalue cells
+ */
+void extractFeatures(const board *b, features *f) {
+    const mask_t all = (((mask_t)1 << g_geo.n) - 1) << 1;
+    lanes_t *cand = arenaAlloc(t_arena, g_geo.cells * sizeof(lanes_t),
+                               CACHELINE);
+    lanes_t *single = arenaAlloc(t_arena, g_geo.cells * sizeof(lanes_t),
+                                 CACHELINE);
+    memset(f, 0, sizeof(*f));
+    for (int c = 0; c < g_geo.cells; c++) {
+        f->clues += 0 != b->cell[c];
+        cand[c] = (lanes_t){ 0 };
+        cand[c][0] = b->cell[c] ? (mask_t)1 << b->cell[c]
+                                : all & ~usedAt(b, c);
+    }
+    lanes_t dead;
+    lockstepPropagate(cand, single, &dead, 0);
+    f->dead = dead[0];
+    for (int c = 0; c < g_geo.cells; c++) {
+        int k = __builtin_popcount(cand[c][0]);
+        if (k < 2) continue;
+        f->empties++;
+        f->hist[k < 5 ? k - 2 : 3]++;
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     10 to the power x and log10, to a few digits, without
+                pulling in libm for the hardness model
+ * In arg:      x         Exponent, or a positive number for logTen
+ * Return val:  The power or the logarithm
+ */
+double powTen(double x) {
+    double r = 1, t = 1;
+    for (; x >= 1; x--) r *= 10;
+    for (; x < 0; x++) r /= 10;
+    // e^(x ln 10) for x in [0, 1) by its Taylor series
+    double y = x * 2.302585092994046, sum = 1;
+    for (int k = 1; k < 20; k++) sum += t *= y / k;
+    return r * sum;
+}
+
+double logTen(double x) {
+    int e = 0;
+    for (; x >= 2; x /= 2) e++;
+    for (; x < 1; x *= 2) e--;
+    // ln x = 2 atanh((x - 1) / (x + 1)), converging fast for x in [1, 2)
+    double z = (x - 1) / (x + 1), z2 = z * z, ln = 0, t = z;
+    for (int k = 1; k < 20; k += 2, t *= z2) ln += t / k;
+    return (e * 0.6931471805599453 + 2 * ln) / 2.302585092994046;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Predicts the cost of a puzzle with g_model and plans its
+                solve: one more worker per ROUTE_WORKER_NODES predicted
+                nodes, up to the pool, running DLX when the puzzle looks
+                harder than ROUTE_DLX_NODES and MRV otherwise. Grids of
+                16x16 and up, where the model was not fit, run CDCL
+ * In arg:      b         Valid board
+                pool      Most workers a solve may get
+ * Return val:  The plan
+ */
+route routePuzzle(const board *b, int pool) {
+    features f;
+    extractFeatures(b, &f);
+    const double x[7] = { 1, f.clues, f.empties, f.hist[0], f.hist[1],
+                          f.hist[2], f.hist[3] };
+    const double scale = 81.0 / g_geo.cells;
+    double lg = g_model[0];
+    for (int i = 1; i < 7; i++) lg += g_model[i] * x[i] * scale;
+
+    route r;
+    r.nodes = f.dead ? 1 : powTen(lg);
+    r.workers = 1 + r.nodes / ROUTE_WORKER_NODES;
+    if (r.workers > pool) r.workers = pool;
+    r.strategy = g_portfolio.len ? -1 : g_geo.box >= 4 ? STRAT_SAT
+               : r.nodes > ROUTE_DLX_NODES ? STRAT_DLX : STRAT_MRV;
+    return r;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Scores a prediction against the solve that followed
+ * In arg:      r         Plan of the solve
+                nodes     Nodes the solve expanded over all threads
+                escalated The solve went to the workers
+ */
+void routeScore(const route *r, uint64_t nodes, bool escalated) {
+    double x = logTen(r->nodes), y = logTen(nodes ? nodes : 1);
+    g_route.n++;
+    g_route.right += (r->nodes > g_adapt.budget) == escalated;
+    g_route.err += x > y ? x - y : y - x;
+    g_route.sx += x;
+    g_route.sy += y;
+    g_route.sxx += x * x;
+    g_route.syy += y * y;
+    g_route.sxy += x * y;
+    if (escalated) {
+        g_route.escalations++;
+        g_route.workers += r->workers;
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Sums a counter of every thread so far
+ * In arg:      off       offsetof the counter in worker_metrics
+ * Return val:  Total
+ */
+uint64_t metricsCount(size_t off) {
+    uint64_t sum = 0;
+    for (int i = 0; i < g_metric_slots; i++) {
+        sum += statGet((uint64_t *)((char *)&g_metrics[i] + off));
+    }
+    return sum;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Sums the nodes expanded by every thread so far
+ * Return val:  Total of the worker_metrics nodes counters
+ */
+uint64_t nodesTotal(void) {
+    return metricsCount(offsetof(worker_metrics, nodes));
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Runs the serial fast path of a solve on the calling
+                thread. If it runs out of budget the rest of its tree
+                is left in g_frontier, split to g_adapt.split subtrees
+                per worker, and g_adapt.escalated is set
+ * In arg:      start         Valid board
+                thread_num    Workers the solve escalates to
+ * Return val:  ST_SOLVED (g_solution set) or ST_UNSOLVABLE if the
+                serial search settled the puzzle, else -1
+ */
+int serialSolve(const board *start, int thread_num) {
+    uint64_t s0 = nowNs(), t0 = traceNow();
+    int target = g_adapt.split * thread_num;
+    frontierInit(&g_frontier, g_geo.cells * g_geo.n + target + MAXN);
+    board b = *start;
+    t_nodes = 0;
+    t_limit = g_adapt.budget;
+    int r = serialKernel(&b, &g_frontier);
+    if (r < 0) frontierExpand(&g_frontier, target);
+    statAdd(&t_metrics->nodes, t_nodes);
+    statAdd(&g_adapt.serial_ns, nowNs() - s0);
+    traceSpan("serial", t0, r);
+
+    g_adapt.escalated = r < 0;
+    if (r < 0) {
+        statAdd(&g_adapt.parallel, 1);
+        return -1;
+    }
+    statAdd(&g_adapt.serial, 1);
+    if (r > 0) g_solution = b;
+    return r > 0 ? ST_SOLVED : ST_UNSOLVABLE;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Points the calling thread's trace ring, lock profile,
+                metrics slot and arena at those of a worker
+ * In arg:      id        Index of the worker, 0 based
+ */
+void workerEnter(int id) {
+    t_ring = g_rings ? &g_rings[id + 1] : NULL;
+    t_lstats = g_lstats ? &g_lstats[(id + 1) * LK_COUNT] : NULL;
+    t_metrics = &g_metrics[id + 1];
+    t_arena = &g_arenas[id + 1];
+    t_nodes = 0;
+    t_rng = (nowNs() ^ 0x9E3779B97F4A7C15ull * (id + 2)) | 1;
+    t_limit = UINT64_MAX;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Each thread solves a sudoku puzzle according to the given
+                starting value
+ * In arg:      boardz structure
+ * Return val:  Ignored
+ */
+void *solveSudoku(void * params) {
+
+    boardz *data = (boardz *) params;
+    data->completed = 0;
+    workerEnter(data->id);
+    uint64_t t0 = traceNow();
+    uint64_t s0 = nowNs();
+    PROBE2(search__start, g_solve_seq, data->id);
+
+    // The scan strategy passes start value and cell to sudokuHelper.
+    // After an escalation the workers share the serial search's leftovers
+    bool found = 0;
+    if (g_adapt.escalated) {
+        for (int sub; !found && (sub = frontierClaim(&g_frontier)) >= 0; ) {
+            // Scratch of one subtree's search is dropped before the next
+            arena mark = *t_arena;
+            data->board = *frontierAt(&g_frontier, sub);
+            found = portfolioSearch(data);
+            *t_arena = mark;
+        }
+    } else {
+        found = portfolioSearch(data);
+    }
+    traceSpan("search", t0, found);
+    PROBE3(search__end, g_solve_seq, data->id, t_nodes);
+    statAdd(&t_metrics->nodes, t_nodes);
+    statAdd(&t_metrics->busy_ns, nowNs() - s0);
+
+    // apply write lock so as to change value of finished
+    wrLock(&g_hot.lock);
+
+    // Exhausting the search space only ends the solve for the last worker
+    if (g_hot.finished == 0 && !found && --g_active > 0) {
+        rwUnlock(&g_hot.lock);
+        traceRecord("exit", traceNow(), 0, data->id);
+        return 0;
+    }
+
+    // If any other thread has not finished
+    if (g_hot.finished == 0) {
+        t0 = traceNow();
+        mtxLock(&mutex);
+        data->completed = found;
+        if (found) g_solution = data->board;
+        if (found) g_portfolio.wins[data->strategy]++;
+        g_status = found ? ST_SOLVED : ST_UNSOLVABLE;
+        g_hot.finished = 1;
+        mtxUnlock(&mutex);
+
+
+        // calculate time taken
+        clock_gettime(CLOCK_MONOTONIC, &g_finish);
+        g_elapsed = (g_finish.tv_sec - g_start.tv_sec);
+        g_elapsed += (double)(g_finish.tv_nsec - g_start.tv_nsec) / 1000000000;
+        metricsSolve(g_status, g_elapsed);
+        PROBE3(solve__end, g_solve_seq, g_status,
+               (uint64_t)(g_elapsed * 1e9));
+
+
+        char *b1; // stores puzzle as string to be sent
+
+        // Converting solved puzzle to string b1
+        if (found) b1 = buffSudoku(&data->board, g_elapsed);
+        else b1 = buffStatus(g_status, g_elapsed);
+        // Send b1 to server
+        if (sockfd >= 0) send(sockfd , b1 , strlen(b1) , 0 );
+        traceSpan("winner send", t0, data->id);
+
+        rwUnlock(&g_hot.lock);
+
+        // Signaling main function to continue execution and terminate process
+        pthread_cond_signal(&is_fin);
+    } else {
+        rwUnlock(&g_hot.lock);
+    }
+
+    traceRecord("exit", traceNow(), 0, data->id);
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Each thread counts the solutions of the subproblems it
+                claims from g_frontier until none is left or the count
+                reaches g_count_cap
+ * In arg:      boardz structure, board used as scratch
+ * Return val:  Ignored
+ */
+void *countSudoku(void *params) {
+    boardz *data = (boardz *) params;
+    workerEnter(data->id);
+    uint64_t s0 = nowNs();
+    PROBE2(search__start, g_solve_seq, data->id);
+
+    int sub;
+    while (__atomic_load_n(&g_hot.found, __ATOMIC_RELAXED) < g_count_cap
+           && (sub = frontierClaim(&g_frontier)) >= 0) {
+        uint64_t t0 = traceNow();
+        data->board = *frontierAt(&g_frontier, sub);
+        countKernel(&data->board, g_count_cap);
+        traceSpan("subtree", t0, data->id);
+    }
+
+    PROBE3(search__end, g_solve_seq, data->id, t_nodes);
+    statAdd(&t_metrics->nodes, t_nodes);
+    statAdd(&t_metrics->busy_ns, nowNs() - s0);
+    traceRecord("exit", traceNow(), 0, data->id);
+    return 0;
+}
+
+
+
+
+
+
+/*-------------------------------------------------------------------
+ * Purpose:     Converts sudoku board to string for socket transmission
+ * In arg:      b             Board containing Sudoku problem
+                                timeo          Elapsed time
+
+
+ * Return val:  A string comprising of the elements of the puzzle
+ */
+char* buffSudoku(board *b, double timeo) {
+    char *buff2 = (char *)arenaAlloc(t_arena, sizeof(buff), 1);
+    int i = 0;
+    int j = 0;
+    int cx = 0, dx;
+    for (i = 0; i < g_geo.n; i++) {
+        for (j = 0; j < g_geo.n; j++) {
+            dx = snprintf(buff2 + cx, sizeof(buff) - cx, "%d ",
+                          b->cell[i * g_geo.n + j]);
+            cx = cx + dx;
+        }
+
+    }
+    dx = snprintf(buff2 + cx, sizeof(buff) - cx, g_batch ? "%f \n" : "%f ",
+                  timeo);
+    cx = cx + dx;
+    return buff2;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Converts an unsuccessful solve to a string for socket
+                transmission
+ * In arg:      status    One of ST_*
+                timeo     Elapsed time
+ * Return val:  Status name followed by the elapsed time
+ */
+char* buffStatus(int status, double timeo) {
+    char *buff2 = (char *)arenaAlloc(t_arena, sizeof(buff), 1);
+    snprintf(buff2, sizeof(buff), g_batch ? "%s %f \n" : "%s %f ",
+             g_status_names[status], timeo);
+    return buff2;
+}
+
+
+
+/*-------------------------------------------------------------------
+ * Purpose:     Converts the result of a count to a string for socket
+                transmission
+ * In arg:      status    ST_UNIQUE, ST_MULTIPLE or a failure status
+                count     Solutions counted, at most g_count_cap if set
+                b         The solution when status is ST_UNIQUE
+                timeo     Elapsed time
+ * Return val:  "unique" and the cells, "multiple" and the count with a
+                '+' if the cap was hit, else as buffStatus
+ */
+char* buffCount(int status, uint64_t count, board *b, double timeo) {
+    if (ST_MULTIPLE == status) {
+        char *buff2 = (char *)arenaAlloc(t_arena, sizeof(buff), 1);
+        snprintf(buff2, sizeof(buff), g_batch ? "%s %llu%s %f \n"
+                 : "%s %llu%s %f ", g_status_names[status],
+                 (unsigned long long)count,
+                 g_count_cap && count >= g_count_cap ? "+" : "",
+                 timeo);
+        return buff2;
+    }
+    if (ST_UNIQUE != status) return buffStatus(status, timeo);
+
+    char *cells = buffSudoku(b, timeo);
+    char *buff2 = (char *)arenaAlloc(t_arena, sizeof(buff), 1);
+    snprintf(buff2, sizeof(buff), "%s %s", g_status_names[status], cells);
+    return buff2;
+}
+
+/* Search state of canonicalize */
+typedef struct
+{
+    const uint8_t *src;         // puzzle, transposed if t.transpose
+    transform cur;              // transform being built
+    uint8_t best[CACHE_CELLS];  // smallest form so far
+    transform t;                // transform giving best
+    long budget;                // row evaluations left
+} canon_state;
+
+/*-------------------------------------------------------------------
+ * Purpose:     Fills in the rows of the canonical form below row i for
+                one column order, keeping in s->best the smallest form
+                seen (digits relabeled in order of appearance, empty
+                cells as n + 1). Rows are taken band by band, so only
+                the symmetries of the puzzle group are tried
+ * In arg:      s         Search state; s->col is the column order
+                i         Output row to choose, rows above are fixed
+                used      Source rows taken, bit r for row r
+                label     Output digit of each source digit seen so far
+                next      Output digits handed out
+ */
+void canonRows(canon_state *s, int i, uint32_t used, const uint8_t *label,
+               int next) {
+    const int n = g_geo.n, B = g_geo.box;
+    if (n == i) {
+        s->t = s->cur;
+        memcpy(s->t.digit, label, n + 1);
+        for (int v = 1; v <= n; v++) {
+            if (0 == s->t.digit[v]) s->t.digit[v] = ++next;
+        }
+        return;
+    }
+    // A new band may be any unused one, else stay in the current band
+    int lo = 0, hi = n;
+    if (0 != i % B) {
+        lo = s->cur.row[i - 1] / B * B;
+        hi = lo + B;
+    }
+    for (int r = lo; r < hi; r++) {
+        if (used >> r & 1 || (0 == i % B && used >> (r / B * B) & 1)) continue;
+        if (--s->budget < 0) return;
+
+        uint8_t lab[MAXN + 1], line[MAXN];
+        int nx = next;
+        memcpy(lab, label, n + 1);
+        for (int c = 0; c < n; c++) {
+            int v = s->src[r * n + s->cur.col[c]];
+            if (v && 0 == lab[v]) lab[v] = ++nx;
+            line[c] = v ? lab[v] : n + 1;
+        }
+        int cmp = memcmp(line, &s->best[i * n], n);
+        if (cmp > 0) continue;
+        if (cmp < 0) {
+            memcpy(&s->best[i * n], line, n);
+            memset(&s->best[(i + 1) * n], 0xFF, (n - 1 - i) * n);
+        }
+        s->cur.row[i] = r;
+        canonRows(s, i + 1, used | 1u << r, lab, nx);
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Orders the columns for the first row s->cur.row[0],
+                pruning every order whose first row is already larger
+                than that of s->best, then chooses the other rows with
+                canonRows. Columns are taken stack by stack
+ * In arg:      s         Search state
+                c         Output column to choose
+                used      Source columns taken, bit x for column x
+                label, next   Digit relabeling so far, see canonRows
+ */
+void canonCols(canon_state *s, int c, uint32_t used, const uint8_t *label,
+               int next) {
+    const int n = g_geo.n, B = g_geo.box, r0 = s->cur.row[0];
+    if (n == c) {
+        canonRows(s, 1, 1u << r0, label, next);
+        return;
+    }
+    // A new stack may be any unused one, else stay in the current stack
+    int lo = 0, hi = n;
+    if (0 != c % B) {
+        lo = s->cur.col[c - 1] / B * B;
+        hi = lo + B;
+    }
+    for (int x = lo; x < hi; x++) {
+        if (used >> x & 1 || (0 == c % B && used >> (x / B * B) & 1)) continue;
+        if (--s->budget < 0) return;
+
+        uint8_t lab[MAXN + 1];
+        int nx = next, v = s->src[r0 * n + x];
+        memcpy(lab, label, n + 1);
+        if (v && 0 == lab[v]) lab[v] = ++nx;
+        int cell = v ? lab[v] : n + 1;
+        if (cell > s->best[c]) continue;
+        if (cell < s->best[c]) {
+            s->best[c] = cell;
+            memset(&s->best[c + 1], 0xFF, g_geo.cells - c - 1);
+        }
+        s->cur.col[c] = x;
+        canonCols(s, c + 1, used | 1u << x, lab, nx);
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Finds the canonical form of a puzzle: the smallest of
+                all its relabelings, row and column permutations within
+                bands and stacks, band and stack swaps and transposes
+ * In arg:      puzzle    Cells of the puzzle, row by row
+ * Out arg:     k         Canonical puzzle, its hash and the transform
+                          from puzzle to it
+ * Return val:  A bool which is false if the puzzle is too large or too
+                symmetric to canonicalize within CANON_BUDGET
+ */
+bool canonicalize(const uint8_t *puzzle, canon_key *k) {
+    const int n = g_geo.n;
+    if (g_geo.cells > CACHE_CELLS) return 0;
+
+    static __thread canon_state s;
+    uint8_t transposed[CACHE_CELLS];
+    for (int c = 0; c < g_geo.cells; c++) {
+        transposed[c] = puzzle[c % n * n + c / n];
+    }
+    memset(s.best, 0xFF, sizeof(s.best));
+    s.budget = CANON_BUDGET;
+
+    // Any row of the puzzle or of its transpose may come first
+    for (int tr = 0; tr < 2; tr++) {
+        s.src = tr ? transposed : puzzle;
+        s.cur.transpose = tr;
+        for (int r = 0; r < n; r++) {
+            uint8_t label[MAXN + 1] = { 0 };
+            s.cur.row[0] = r;
+            canonCols(&s, 0, 0, label, 0);
+            if (s.budget < 0) return 0;
+        }
+    }
+
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (int c = 0; c < g_geo.cells; c++) {
+        k->cells[c] = s.best[c] > n ? 0 : s.best[c];
+        h = (h ^ k->cells[c]) * 0x100000001b3ull;
+    }
+    k->hash = h ? h : 1;
+    k->t = s.t;
+    return 1;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Maps a full board through a transform, or back
+ * In arg:      t         Transform from the puzzle to its canonical form
+                in        Board in the puzzle's orientation if forward,
+                          else canonical cells
+                forward   Direction of the mapping
+ * Out arg:     out       Mapped cells, row by row
+ */
+void transformCells(const transform *t, const uint8_t *in, uint8_t *out,
+                    bool forward) {
+    const int n = g_geo.n;
+    uint8_t inverse[MAXN + 1];
+    for (int v = 1; v <= n; v++) inverse[t->digit[v]] = v;
+    for (int r = 0; r < n; r++) {
+        for (int c = 0; c < n; c++) {
+            int sr = t->row[r], sc = t->col[c];
+            int src = t->transpose ? sc * n + sr : sr * n + sc;
+            if (forward) out[r * n + c] = t->digit[in[src]];
+            else out[src] = inverse[in[r * n + c]];
+        }
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Looks up the result of a puzzle in the cache
+ * In arg:      k         Canonical form of the puzzle
+ * Out arg:     sol       Solution in the puzzle's orientation, when solved
+ * Return val:  Cached status, -1 on a miss
+ */
+int cacheGet(const canon_key *k, board *sol) {
+    cache_shard *sh = &g_cache[k->hash >> 58];
+    for (size_t i = 0; i < CACHE_PROBE; i++) {
+        cache_entry *e = &sh->slot[(k->hash + i) & (g_cache_slots - 1)];
+        uint32_t seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1 || e->hash != k->hash) continue;
+
+        cache_entry copy = *e;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (seq != __atomic_load_n(&e->seq, __ATOMIC_RELAXED)
+            || 0 != memcmp(copy.puzzle, k->cells, g_geo.cells)) continue;
+
+        if (ST_SOLVED == copy.status) {
+            grid cells;
+            transformCells(&k->t, copy.solution, cells, 0);
+            boardLoad(sol, cells);
+        }
+        __atomic_fetch_add(&sh->hits, 1, __ATOMIC_RELAXED);
+        return copy.status;
+    }
+    __atomic_fetch_add(&sh->misses, 1, __ATOMIC_RELAXED);
+    return -1;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Stores the result of a puzzle in the cache, in an empty
+                slot of its probe window or else over the slot its hash
+                picks there
+ * In arg:      k         Canonical form of the puzzle
+                status    ST_SOLVED or ST_UNSOLVABLE
+                sol       Solution in the puzzle's orientation, if solved
+ */
+void cachePut(const canon_key *k, int status, const board *sol) {
+    cache_shard *sh = &g_cache[k->hash >> 58];
+    size_t at = (k->hash + (k->hash >> 32) % CACHE_PROBE) & (g_cache_slots - 1);
+    // Only a hint: a racing writer at worst makes the store go elsewhere
+    for (size_t i = 0; i < CACHE_PROBE; i++) {
+        cache_entry *e = &sh->slot[(k->hash + i) & (g_cache_slots - 1)];
+        uint64_t h = __atomic_load_n(&e->hash, __ATOMIC_RELAXED);
+        if (h == k->hash) return;
+        if (0 == h) {
+            at = (k->hash + i) & (g_cache_slots - 1);
+            break;
+        }
+    }
+    cache_entry *e = &sh->slot[at];
+    uint32_t seq = __atomic_load_n(&e->seq, __ATOMIC_RELAXED);
+    if (seq & 1 || !__atomic_compare_exchange_n(&e->seq, &seq, seq + 1, 0,
+                                                __ATOMIC_ACQUIRE,
+                                                __ATOMIC_RELAXED)) {
+        return;   // another writer has the slot; dropping is fine
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    e->status = status;
+    e->hash = k->hash;
+    memcpy(e->puzzle, k->cells, g_geo.cells);
+    if (ST_SOLVED == status) transformCells(&k->t, sol->cell, e->solution, 1);
+    __atomic_store_n(&e->seq, seq + 2, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&sh->inserts, 1, __ATOMIC_RELAXED);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Sets up the result cache
+ * In arg:      entries   Total slots wanted, rounded up to a power of two,
+                          at most CACHE_MAX_SLOTS per shard
+ * Return val:  0 on success, -1 if the cache could not be allocated
+ */
+int cacheInit(size_t entries) {
+    size_t slots = 16;
+    while (slots * CACHE_SHARDS < entries && slots < CACHE_MAX_SLOTS) {
+        slots *= 2;
+    }
+    for (int i = 0; i < CACHE_SHARDS; i++) {
+        g_cache[i].slot = calloc(slots, sizeof(cache_entry));
+        if (NULL == g_cache[i].slot) {
+            fprintf(stderr, "-H: cannot allocate %zu bytes\n",
+                    slots * CACHE_SHARDS * sizeof(cache_entry));
+            while (i-- > 0) free(g_cache[i].slot);
+            return -1;
+        }
+    }
+    g_cache_slots = slots;
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Sums a counter over the cache shards
+ * In arg:      off       offsetof the counter in cache_shard
+ * Return val:  Total
+ */
+uint64_t cacheCount(size_t off) {
+    uint64_t sum = 0;
+    for (int i = 0; i < CACHE_SHARDS; i++) {
+        sum += statGet((uint64_t *)((char *)&g_cache[i] + off));
+    }
+    return sum;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Packs up to CACHE_CELLS cells of at most 15 into 4 bits
+                each, or unpacks them
+ * In arg:      in        Cells if pack, else STORE_PACKED bytes
+                pack      Direction
+ * Out arg:     out       STORE_PACKED bytes if pack, else g_geo.cells cells
+ */
+void storeNibbles(const uint8_t *in, uint8_t *out, bool pack) {
+    if (pack) memset(out, 0, STORE_PACKED);
+    for (int c = 0; c < g_geo.cells; c++) {
+        if (pack) out[c >> 1] |= in[c] << (c & 1) * 4;
+        else out[c] = in[c >> 1] >> (c & 1) * 4 & 0xF;
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Maps the solution store file, creating it if it is new.
+                The process that gets the exclusive file lock appends to
+                it; any other opens it read only. Nothing is read or
+                rebuilt, so opening takes the same time at any size. A
+                reader that finds the file still being set up by its
+                writer waits up to STORE_WAIT_MS for the header
+ * In arg:      path      Store file
+ * Return val:  0 on success, -1 if the file is unusable
+ */
+int storeOpen(const char *path) {
+    if (g_geo.cells > CACHE_CELLS) {
+        fprintf(stderr, "%s: the store holds 9x9 and 4x4 puzzles only\n",
+                path);
+        return -1;
+    }
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    bool writer = fd >= 0 && 0 == flock(fd, LOCK_EX | LOCK_NB);
+    if (fd < 0 && (fd = open(path, O_RDONLY)) < 0) {
+        perror(path);
+        return -1;
+    }
+
+    struct stat st;
+    if (0 != fstat(fd, &st)) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    size_t size = st.st_size;
+    char magic[8] = { 0 };
+    for (int ms = 0; !writer && ms < STORE_WAIT_MS; ms += 10) {
+        // The writer creates the file, then sizes it, then writes the
+        // header; the magic is the last of these to appear
+        if (size >= STORE_HEADER
+            && sizeof(magic) == pread(fd, magic, sizeof(magic), 0)
+            && 0 == memcmp(magic, "sudstore", 8)) {
+            break;
+        }
+        nanosleep(&(struct timespec){ .tv_nsec = 10000000 }, NULL);
+        if (0 == fstat(fd, &st)) size = st.st_size;
+    }
+    if (0 == size && writer) {
+        // Sparse: only pages that records land on take disk space
+        size = STORE_HEADER + (size_t)STORE_SLOTS * sizeof(store_record);
+        store_header h = { .magic = "sudstore", .version = STORE_VERSION,
+                           .box = g_geo.box, .slots = STORE_SLOTS };
+        if (0 != ftruncate(fd, size)
+            || (ssize_t)sizeof(h) != pwrite(fd, &h, sizeof(h), 0)) {
+            perror(path);
+            close(fd);
+            return -1;
+        }
+    }
+
+    store_header *head = size < STORE_HEADER ? MAP_FAILED
+                       : mmap(NULL, size, PROT_READ | (writer ? PROT_WRITE : 0),
+                              MAP_SHARED, fd, 0);
+    close(fd);   // the mapping and the lock stay until exit
+    if (MAP_FAILED == head) {
+        fprintf(stderr, "%s: not a solution store\n", path);
+        return -1;
+    }
+    if (0 != memcmp(head->magic, "sudstore", 8)
+        || STORE_VERSION != head->version
+        || head->slots & (head->slots - 1)
+        || STORE_HEADER + head->slots * sizeof(store_record) > size) {
+        fprintf(stderr, "%s: not a version %d solution store\n", path,
+                STORE_VERSION);
+        munmap(head, size);
+        return -1;
+    }
+    if ((int)head->box != g_geo.box) {
+        fprintf(stderr, "%s: store holds box %u puzzles, not %d\n", path,
+                head->box, g_geo.box);
+        munmap(head, size);
+        return -1;
+    }
+    g_store.head = head;
+    g_store.rec = (store_record *)((char *)head + STORE_HEADER);
+    g_store.size = size;
+    g_store.writer = writer;
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Finds the slot of a puzzle in the solution store
+ * In arg:      k         Canonical form of the puzzle
+                packed    k->cells as packed by storeNibbles
+ * Return val:  The record of the puzzle, else the empty slot it would
+                go to, or NULL if the probe window is full
+ */
+store_record *storeFind(const canon_key *k, const uint8_t *packed) {
+    const uint64_t m = g_store.head->slots - 1;
+    for (uint64_t i = 0; i < STORE_PROBE; i++) {
+        store_record *r = &g_store.rec[(k->hash + i) & m];
+        uint64_t h = __atomic_load_n(&r->hash, __ATOMIC_ACQUIRE);
+        if (0 == h) return r;
+        if (h == k->hash && 0 == memcmp(r->puzzle, packed, STORE_PACKED)) {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Looks up the result of a puzzle in the solution store
+ * In arg:      k         Canonical form of the puzzle
+ * Out arg:     sol       Solution in the puzzle's orientation, when solved
+ * Return val:  Stored status, -1 if the puzzle is not in the store
+ */
+int storeGet(const canon_key *k, board *sol) {
+    uint8_t packed[STORE_PACKED];
+    storeNibbles(k->cells, packed, 1);
+    store_record *r = storeFind(k, packed);
+    if (NULL == r || 0 == __atomic_load_n(&r->hash, __ATOMIC_ACQUIRE)) {
+        __atomic_fetch_add(&g_store.misses, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    if (ST_SOLVED == r->status) {
+        grid canon, cells;
+        storeNibbles(r->solution, canon, 0);
+        transformCells(&k->t, canon, cells, 0);
+        boardLoad(sol, cells);
+    }
+    __atomic_fetch_add(&g_store.hits, 1, __ATOMIC_RELAXED);
+    return r->status;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Appends the result of a puzzle to the solution store,
+                unless it is there already, the store is read only or
+                the puzzle's probe window is full
+ * In arg:      k         Canonical form of the puzzle
+                status    ST_SOLVED or ST_UNSOLVABLE
+                sol       Solution in the puzzle's orientation, if solved
+ */
+void storePut(const canon_key *k, int status, const board *sol) {
+    if (!g_store.writer) return;
+    uint8_t packed[STORE_PACKED];
+    storeNibbles(k->cells, packed, 1);
+    store_record *r = storeFind(k, packed);
+    if (NULL == r || 0 != r->hash) return;
+
+    r->status = status;
+    memcpy(r->puzzle, packed, STORE_PACKED);
+    if (ST_SOLVED == status) {
+        grid canon;
+        transformCells(&k->t, sol->cell, canon, 1);
+        storeNibbles(canon, r->solution, 1);
+    }
+    __atomic_store_n(&r->hash, k->hash, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&g_store.head->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&g_store.inserts, 1, __ATOMIC_RELAXED);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Ends a solve settled on the calling thread, without the
+                workers: times it, records it and sends the result
+ * In arg:      status    ST_SOLVED, with the board in g_solution, or
+                          ST_UNSOLVABLE
+ * Return val:  status
+ */
+int solveInline(int status) {
+    g_status = status;
+    clock_gettime(CLOCK_MONOTONIC, &g_finish);
+    g_elapsed = (g_finish.tv_sec - g_start.tv_sec);
+    g_elapsed += (double)(g_finish.tv_nsec - g_start.tv_nsec) / 1000000000;
+    metricsSolve(g_status, g_elapsed);
+    PROBE3(solve__end, g_solve_seq, g_status, (uint64_t)(g_elapsed * 1e9));
+    char *b1 = ST_SOLVED == status ? buffSudoku(&g_solution, g_elapsed)
+                                   : buffStatus(g_status, g_elapsed);
+    if (sockfd >= 0) send(sockfd , b1 , strlen(b1) , 0 );
+    statSet(&g_in_flight, 0);
+    return g_status;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Solves one puzzle with thread_num racing workers and sends
+                the result to the server
+ * In arg:      puzzle        Cells of the Sudoku problem, see grid; the
+                              cache and the store file results under it
+                from          Where the search starts: puzzle, or the
+                              puzzle with cells already deduced from it
+                thread_num    Number of worker threads
+ * Return val:  Status of the solve, one of ST_*
+ */
+int solvePuzzle(const uint8_t *puzzle, const uint8_t *from, int thread_num) {
+
+    g_hot.finished = 0;
+    g_active = thread_num;
+    g_solve_seq++;
+    statSet(&g_in_flight, 1);
+    PROBE2(solve__start, g_solve_seq, thread_num);
+
+    // Workers of the previous solve are joined; their memory is free again
+    for (int i = 0; i <= thread_num; i++) {
+        arenaReset(&g_arenas[i]);
+    }
+
+    // Start measuring time
+    clock_gettime(CLOCK_MONOTONIC, &g_start);
+
+    board start;
+    if (!boardLoad(&start, from)) {
+        g_status = ST_INVALID;
+        metricsSolve(ST_INVALID, 0);
+        PROBE3(solve__end, g_solve_seq, ST_INVALID, 0);
+        char *b1 = buffStatus(ST_INVALID, 0);
+        if (sockfd >= 0) send(sockfd , b1 , strlen(b1) , 0 );
+        statSet(&g_in_flight, 0);
+        return ST_INVALID;
+    }
+
+    // Repeats of a puzzle, in any orientation, skip the search
+    canon_key key;
+    bool keyed = (g_cache_slots || g_store.head) && canonicalize(puzzle, &key);
+    int cached = keyed && g_cache_slots ? cacheGet(&key, &g_solution) : -1;
+    if (cached < 0 && keyed && g_store.head) {
+        cached = storeGet(&key, &g_solution);
+        if (cached >= 0 && g_cache_slots) cachePut(&key, cached, &g_solution);
+    }
+    if (cached >= 0) return solveInline(cached);
+
+    // Without an explicit thread count the model sizes the solve
+    route plan = { 0, thread_num, -1 };
+    uint64_t nodes0 = 0;
+    if (g_route.on) {
+        plan = routePuzzle(&start, thread_num);
+        thread_num = plan.workers;
+        g_active = thread_num;
+        nodes0 = nodesTotal();
+    }
+
+    // Most puzzles fall to a short serial search, cheaper than the threads
+    g_adapt.escalated = 0;
+    int serial = g_adapt.budget ? serialSolve(&start, thread_num) : -1;
+    if (serial >= 0) {
+        if (keyed && g_cache_slots) cachePut(&key, serial, &g_solution);
+        if (keyed && g_store.head) storePut(&key, serial, &g_solution);
+        if (g_route.on) routeScore(&plan, nodesTotal() - nodes0, 0);
+        return solveInline(serial);
+    }
+
+    boardz *p[thread_num];
+
+    // Allocating memory and initializing structures for thread parameters
+    for (int i = 0; i < thread_num; i++) {
+        p[i] = (boardz *) arenaAlloc(&g_arenas[i + 1], sizeof(boardz),
+                                     CACHELINE);
+
+        p[i]->board = start;
+
+        p[i]->id = i;
+        p[i]->completed = 0;
+        p[i]->start = (float)g_geo.n/thread_num * i;
+        p[i]->cell = rngNext(&t_rng) % g_geo.cells;
+        p[i]->strategy = plan.strategy >= 0 ? plan.strategy
+                       : g_portfolio.len
+                       ? g_portfolio.list[i % g_portfolio.len] : STRAT_SCAN;
+        g_portfolio.races[p[i]->strategy]++;
+    }
+
+    pthread_t t[thread_num];
+    // Starting threads
+    for (int i = 0; i < thread_num; i++) {
+        uint64_t t0 = traceNow();
+        pthread_create(&t[i], &g_worker_attr, solveSudoku, (void *) p[i]);
+        traceSpan("spawn", t0, i);
+    }
+
+
+    uint64_t t0 = traceNow();
+    mtxLock(&mutex);
+
+    // Waiting till one of the threads has completed execution
+    while (0 == g_hot.finished)  condWait(&is_fin, &mutex);
+
+
+    mtxUnlock(&mutex);
+    traceSpan("wait is_fin", t0, 0);
+
+    // Losing threads notice g_hot.finished at their next poll and exit
+    for (int i = 0; i < thread_num; i++) {
+        pthread_join(t[i], NULL);
+    }
+    if (keyed && g_cache_slots) cachePut(&key, g_status, &g_solution);
+    if (keyed && g_store.head) storePut(&key, g_status, &g_solution);
+    if (g_route.on) routeScore(&plan, nodesTotal() - nodes0, 1);
+    statSet(&g_in_flight, 0);
+    return g_status;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Counts the solutions of one puzzle up to g_count_cap and
+                sends the result to the server. The search tree is split
+                into a frontier of disjoint subtrees that thread_num
+                workers share out, so no subtree is searched twice
+ * In arg:      puzzle        Cells of the Sudoku problem, see grid
+                thread_num    Number of worker threads
+ * Return val:  Status of the count: ST_UNIQUE, ST_MULTIPLE, ST_UNSOLVABLE
+                or ST_INVALID
+ */
+int countPuzzle(const uint8_t *puzzle, int thread_num) {
+
+    g_solve_seq++;
+    statSet(&g_in_flight, 1);
+    PROBE2(solve__start, g_solve_seq, thread_num);
+
+    for (int i = 0; i <= thread_num; i++) {
+        arenaReset(&g_arenas[i]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &g_start);
+
+    board start;
+    uint64_t found = 0;
+    g_status = ST_INVALID;
+    g_elapsed = 0;
+    if (boardLoad(&start, puzzle)) {
+        uint64_t t0 = traceNow();
+        frontierSplit(&g_frontier, &start, FRONTIER_SPLIT * thread_num);
+        traceSpan("split", t0, g_frontier.count);
+        g_hot.found = 0;
+
+        boardz *p[thread_num];
+        pthread_t t[thread_num];
+        for (int i = 0; i < thread_num; i++) {
+            p[i] = (boardz *) arenaAlloc(&g_arenas[i + 1], sizeof(boardz),
+                                         CACHELINE);
+            p[i]->id = i;
+            t0 = traceNow();
+            pthread_create(&t[i], &g_worker_attr, countSudoku,
+                           (void *) p[i]);
+            traceSpan("spawn", t0, i);
+        }
+        // Workers stop by themselves once the frontier is used up
+        for (int i = 0; i < thread_num; i++) {
+            pthread_join(t[i], NULL);
+        }
+
+        // Workers racing past the cap may overshoot it by a little
+        found = g_hot.found < g_count_cap ? g_hot.found : g_count_cap;
+        g_status = 0 == found ? ST_UNSOLVABLE
+                 : 1 == found ? ST_UNIQUE : ST_MULTIPLE;
+        clock_gettime(CLOCK_MONOTONIC, &g_finish);
+        g_elapsed = (g_finish.tv_sec - g_start.tv_sec);
+        g_elapsed += (double)(g_finish.tv_nsec - g_start.tv_nsec) / 1000000000;
+    }
+
+    metricsSolve(g_status, g_elapsed);
+    PROBE3(solve__end, g_solve_seq, g_status, (uint64_t)(g_elapsed * 1e9));
+    char *b1 = buffCount(g_status, found, &g_first, g_elapsed);
+    if (sockfd >= 0) send(sockfd , b1 , strlen(b1) , 0 );
+    statSet(&g_in_flight, 0);
+    return g_status;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Reports a solve that finished without the worker threads:
+                records metrics and probes and sends the result
+ * In arg:      status    One of ST_*
+                b         Solved board, used when status is ST_SOLVED
+                seconds   Latency of the solve
+ */
+void reportSolve(int status, board *b, double seconds) {
+    g_solve_seq++;
+    PROBE2(solve__start, g_solve_seq, 0);
+    g_status = status;
+    g_elapsed = seconds;
+    metricsSolve(status, seconds);
+    PROBE3(solve__end, g_solve_seq, status, (uint64_t)(seconds * 1e9));
+    char *b1 = ST_SOLVED == status ? buffSudoku(b, seconds)
+                                   : buffStatus(status, seconds);
+    if (sockfd >= 0) send(sockfd , b1 , strlen(b1) , 0 );
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Finds the lanes whose sets have at most k members;
+                popcount has no vector form, so the k lowest bits are
+                cleared and what is left compared with zero
+ * In arg:      s         Sets, one per lane
+                k         Most members
+ * Out arg:     s         All ones in the lanes with at most k members
+ */
+KERNEL void lanesAtMost(lanes_t *s, int k) {
+    lanes_t m = *s;
+    for (int i = 0; i < k; i++) m &= m - 1;
+    *s = (lanes_t)(m == 0);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Locked candidates in every lane: for each box and each
+                line crossing it, a digit of the box confined to the
+                crossing leaves the rest of the line (pointing), and one
+                of the line confined to it leaves the rest of the box
+                (claiming)
+ * In arg:      cand      Candidate planes, one vector per cell
+ * Out arg:     cand      Candidates with the locked digits removed
+                changed   Gets the bits removed, per lane
+ */
+void lanesLocked(lanes_t *cand, lanes_t *changed) {
+    const int n = g_geo.n, box = g_geo.box;
+    for (int bx = 0; bx < n; bx++) {
+        const uint16_t *cells = &g_geo.unitCells[(2 * n + bx) * n];
+        for (int cols = 0; cols < 2; cols++) {
+            for (int i = 0; i < box; i++) {
+                // Box positions k run row by row, box wide
+                int line = cols ? n + bx % box * box + i : bx / box * box + i;
+                const uint16_t *lc = &g_geo.unitCells[line * n];
+                lanes_t seg = { 0 }, boxRest = { 0 }, lineRest = { 0 };
+                for (int k = 0; k < n; k++) {
+                    if ((cols ? k % box : k / box) == i) seg |= cand[cells[k]];
+                    else boxRest |= cand[cells[k]];
+                    if (g_geo.boxOf[lc[k]] != bx) lineRest |= cand[lc[k]];
+                }
+                lanes_t point = seg & ~boxRest, claim = seg & ~lineRest;
+                for (int k = 0; k < n; k++) {
+                    if (g_geo.boxOf[lc[k]] != bx) {
+                        *changed |= cand[lc[k]] & point;
+                        cand[lc[k]] &= ~point;
+                    }
+                    if ((cols ? k % box : k / box) != i) {
+                        *changed |= cand[cells[k]] & claim;
+                        cand[cells[k]] &= ~claim;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* Applies a pattern of k sets whose union uni has at most k members in
+   the lanes of hit; pick lists the sets, arg is as for lanesSubsetFind.
+   Vectors go by pointer: by value they would change the ABI with AVX */
+typedef void (*lanes_hit_fn)(lanes_t *cand, const int *pick, int k,
+                             const lanes_t *uni, const lanes_t *hit, int arg,
+                             lanes_t *changed);
+
+/*-------------------------------------------------------------------
+ * Purpose:     Lane version of subsetFind: every choice of k of n sets
+                whose union has at most k members in some lane. Sets are
+                the same in every lane, only their contents differ, so a
+                branch is cut once all lanes have outgrown k
+ * In arg:      sets      n sets per lane; ones of size 0 or 1 should be
+                          all ones so that they never join a pattern
+                k         Size of the pattern
+                from      First set still to choose from
+                pick      Sets chosen so far, chosen of them
+                uni       Their union
+                hit, cand, arg    Pattern callback and what it gets
+ * Out arg:     changed   Gets the bits removed, per lane
+ */
+void lanesSubsetFind(const lanes_t *sets, int k, int from, int *pick,
+                     int chosen, const lanes_t *uni, lanes_hit_fn hit,
+                     lanes_t *cand, int arg, lanes_t *changed) {
+    for (int i = from; i <= g_geo.n - (k - chosen); i++) {
+        lanes_t u = *uni | sets[i], fit = u;
+        lanesAtMost(&fit, k);
+        bool any = 0;
+        for (int l = 0; l < LANES; l++) any |= fit[l] != 0;
+        if (!any) continue;
+        pick[chosen] = i;
+        if (chosen + 1 < k) {
+            lanesSubsetFind(sets, k, i + 1, pick, chosen + 1, &u, hit, cand,
+                            arg, changed);
+        } else {
+            hit(cand, pick, k, &u, &fit, arg, changed);
+        }
+    }
+}
+
+/* k cells of unit arg holding at most k digits: the rest of the unit
+   loses them. Sets are the positions of the unit */
+void lanesNakedHit(lanes_t *cand, const int *pick, int k, const lanes_t *uni,
+                   const lanes_t *hit, int arg, lanes_t *changed) {
+    const uint16_t *cells = &g_geo.unitCells[arg * g_geo.n];
+    uint32_t in = 0;
+    for (int j = 0; j < k; j++) in |= 1u << pick[j];
+    lanes_t elim = *uni & *hit;
+    for (int p = 0; p < g_geo.n; p++) {
+        if (in >> p & 1) continue;
+        *changed |= cand[cells[p]] & elim;
+        cand[cells[p]] &= ~elim;
+    }
+}
+
+/* k digits of unit arg confined to k cells: those cells lose every
+   other digit. Set d - 1 holds the positions of digit d */
+void lanesHiddenHit(lanes_t *cand, const int *pick, int k,
+                    const lanes_t *uni, const lanes_t *hit, int arg,
+                    lanes_t *changed) {
+    const uint16_t *cells = &g_geo.unitCells[arg * g_geo.n];
+    mask_t digits = 0;
+    for (int j = 0; j < k; j++) digits |= (mask_t)2 << pick[j];
+    for (int p = 0; p < g_geo.n; p++) {
+        lanes_t elim = (lanes_t)((*uni >> p & 1) != 0) & *hit & ~digits;
+        *changed |= cand[cells[p]] & elim;
+        cand[cells[p]] &= ~elim;
+    }
+}
+
+/* Digit arg % 32 confined to k cover lines in k base lines: the cover
+   lines lose it in the other base lines. Base lines are rows if
+   arg < 32, else columns; set b holds the cover lines of base line b */
+void lanesFishHit(lanes_t *cand, const int *pick, int k, const lanes_t *uni,
+                  const lanes_t *hit, int arg, lanes_t *changed) {
+    const int n = g_geo.n;
+    const bool rows = arg < 32;
+    const mask_t bit = (mask_t)1 << arg % 32;
+    uint32_t base = 0;
+    for (int j = 0; j < k; j++) base |= 1u << pick[j];
+    for (int x = 0; x < n; x++) {
+        lanes_t elim = (lanes_t)((*uni >> x & 1) != 0) & *hit & bit;
+        for (int b = 0; b < n; b++) {
+            if (base >> b & 1) continue;
+            int c = rows ? b * n + x : x * n + b;
+            *changed |= cand[c] & elim;
+            cand[c] &= ~elim;
+        }
+    }
+}
+
+/* Sets of size 0 or 1 become all ones, see lanesSubsetFind */
+KERNEL void lanesWide(lanes_t *s) {
+    *s |= (lanes_t)((*s & (*s - 1)) == 0);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Naked and hidden pairs and triples in every unit and
+                lane. Hidden subsets run on the transposed planes: set
+                d - 1 of a unit has bit p when position p may hold d
+ * In arg:      cand      Candidate planes, one vector per cell
+ * Out arg:     cand      Reduced candidates
+                changed   Gets the bits removed, per lane
+ */
+void lanesSubsets(lanes_t *cand, lanes_t *changed) {
+    const int n = g_geo.n;
+    const lanes_t none = { 0 };
+    lanes_t sets[MAXN];
+    int pick[3];
+    for (int k = 2; k <= 3; k++) {
+        for (int u = 0; u < 3 * n; u++) {
+            const uint16_t *cells = &g_geo.unitCells[u * n];
+            for (int p = 0; p < n; p++) {
+                sets[p] = cand[cells[p]];
+                lanesWide(&sets[p]);
+            }
+            lanesSubsetFind(sets, k, 0, pick, 0, &none, lanesNakedHit, cand,
+                            u, changed);
+            for (int d = 0; d < n; d++) sets[d] = none;
+            for (int p = 0; p < n; p++) {
+                lanes_t m = cand[cells[p]];
+                for (int d = 0; d < n; d++) sets[d] |= (m >> (d + 1) & 1) << p;
+            }
+            for (int d = 0; d < n; d++) lanesWide(&sets[d]);
+            lanesSubsetFind(sets, k, 0, pick, 0, &none, lanesHiddenHit, cand,
+                            u, changed);
+        }
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     X-Wing and Swordfish for every digit and lane, rows and
+                columns as base lines
+ * In arg:      cand      Candidate planes, one vector per cell
+ * Out arg:     cand      Reduced candidates
+                changed   Gets the bits removed, per lane
+ */
+void lanesFish(lanes_t *cand, lanes_t *changed) {
+    const int n = g_geo.n;
+    const lanes_t none = { 0 };
+    lanes_t sets[MAXN];
+    int pick[3];
+    for (int k = 2; k <= 3; k++) {
+        for (int v = 1; v <= n; v++) {
+            for (int rows = 1; rows >= 0; rows--) {
+                for (int b = 0; b < n; b++) {
+                    lanes_t where = { 0 };
+                    for (int x = 0; x < n; x++) {
+                        int c = rows ? b * n + x : x * n + b;
+                        where |= (cand[c] >> v & 1) << x;
+                    }
+                    sets[b] = where;
+                    lanesWide(&sets[b]);
+                }
+                lanesSubsetFind(sets, k, 0, pick, 0, &none, lanesFishHit,
+                                cand, rows ? v : 32 + v, changed);
+            }
+        }
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Propagates LANES puzzles in lockstep with naked and hidden
+                singles until no live lane changes. Every step is the same
+                vector instruction for all lanes, so a lane that is done
+                simply stops changing. Once singles are stuck, the tiers
+                up to level are tried easiest first, and singles resume
+                after the first one that removes a candidate
+ * In arg:      cand      Candidate planes, one vector per cell
+                single    Scratch, one vector per cell
+                level     Highest tier, see g_prop_names
+ * Out arg:     cand      Propagated candidates
+                deadp     All ones in lanes that hit a contradiction
+ */
+void lockstepPropagate(lanes_t *cand, lanes_t *single, lanes_t *deadp,
+                       int level) {
+    const int n = g_geo.n;
+    const mask_t all = (((mask_t)1 << n) - 1) << 1;
+    lanes_t dead = { 0 };
+
+    for (;;) {
+        lanes_t changed = { 0 };
+
+        // Naked singles: a solved cell removes its digit from its peers
+        for (int c = 0; c < g_geo.cells; c++) {
+            lanes_t m = cand[c];
+            single[c] = m & (lanes_t)(((m & (m - 1)) == 0) & (m != 0));
+        }
+        for (int c = 0; c < g_geo.cells; c++) {
+            const uint16_t *peer = &g_geo.peers[c * g_geo.npeers];
+            lanes_t elim = { 0 };
+            for (int k = 0; k < g_geo.npeers; k++) elim |= single[peer[k]];
+            lanes_t m = cand[c] & ~elim;
+            changed |= m ^ cand[c];
+            cand[c] = m;
+            dead |= (lanes_t)(m == 0);
+        }
+
+        // Hidden singles: a digit with one place left in a unit goes there
+        for (int u = 0; u < 3 * n; u++) {
+            const uint16_t *cells = &g_geo.unitCells[u * n];
+            lanes_t once = { 0 }, twice = { 0 };
+            for (int k = 0; k < n; k++) {
+                twice |= once & cand[cells[k]];
+                once |= cand[cells[k]];
+            }
+            dead |= (lanes_t)(once != all);
+            lanes_t exact = once & ~twice;
+            for (int k = 0; k < n; k++) {
+                lanes_t m = cand[cells[k]];
+                lanes_t hit = m & exact;
+                lanes_t sel = (lanes_t)(hit != 0);
+                lanes_t next = (hit & sel) | (m & ~sel);
+                changed |= next ^ m;
+                cand[cells[k]] = next;
+            }
+        }
+
+        bool live = 0;
+        for (int l = 0; l < LANES; l++) live |= changed[l] && !dead[l];
+        for (int t = 1; !live && t <= level; t++) {
+            changed = (lanes_t){ 0 };
+            if (1 == t) lanesLocked(cand, &changed);
+            else if (2 == t) lanesSubsets(cand, &changed);
+            else lanesFish(cand, &changed);
+            for (int l = 0; l < LANES; l++) live |= changed[l] && !dead[l];
+        }
+        if (!live) break;
+    }
+    *deadp = dead;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Solves up to LANES batch puzzles together. Propagation
+                runs in lockstep across vector lanes; puzzles it solves or
+                refutes are reported at once, the others are peeled off
+                to the threaded backtracker with their deduced cells
+ * In arg:      jobs          Puzzles of the batch
+                count         Puzzles left in the batch
+                thread_num    Workers for peeled puzzles
+ * Out arg:     lat, wall     Latency and cost of each puzzle, see
+                              benchStats; may be NULL
+ * Return val:  Number of puzzles consumed, at most LANES
+ */
+int solveGroup(grid *jobs, int count, int thread_num, double *lat,
+               double *wall) {
+    const int n = g_geo.n;
+    const mask_t all = (((mask_t)1 << n) - 1) << 1;
+    if (count > LANES) count = LANES;
+
+    uint64_t t0 = nowNs();
+    arenaReset(&g_arenas[0]);
+    lanes_t *cand = arenaAlloc(&g_arenas[0], g_geo.cells * sizeof(lanes_t),
+                               CACHELINE);
+    lanes_t *single = arenaAlloc(&g_arenas[0], g_geo.cells * sizeof(lanes_t),
+                                 CACHELINE);
+    bool invalid[LANES];
+    board b;
+
+    statSet(&g_in_flight, count);
+    for (int l = 0; l < LANES; l++) {
+        invalid[l] = l < count && !boardLoad(&b, jobs[l]);
+    }
+    for (int c = 0; c < g_geo.cells; c++) {
+        for (int l = 0; l < LANES; l++) {
+            int v = l < count && !invalid[l] ? jobs[l][c] : 0;
+            cand[c][l] = v ? (mask_t)1 << v : all;
+        }
+    }
+    lanes_t dead;
+    lockstepPropagate(cand, single, &dead, g_prop_level);
+    double shared = (nowNs() - t0) / 1e9;
+
+    // Results are copied out before the peeled solves reuse the arena
+    grid deduced[LANES];
+    int status[LANES];
+    for (int l = 0; l < count; l++) {
+        bool solved = 1;
+        for (int c = 0; c < g_geo.cells; c++) {
+            mask_t m = cand[c][l];
+            bool one = m && !(m & (m - 1));
+            deduced[l][c] = one ? __builtin_ctz(m) : 0;
+            solved &= one;
+        }
+        status[l] = invalid[l] ? ST_INVALID : dead[l] ? ST_UNSOLVABLE
+                  : solved ? ST_SOLVED : -1;
+    }
+
+    for (int l = 0; l < count; l++) {
+        double cost = shared / count;
+        canon_key key;
+        if (status[l] >= 0) {
+            // Filed under the puzzle as sent, as solvePuzzle does
+            boardLoad(&b, deduced[l]);
+            if (ST_INVALID != status[l] && (g_cache_slots || g_store.head)
+                && canonicalize(jobs[l], &key)) {
+                if (g_cache_slots) cachePut(&key, status[l], &b);
+                if (g_store.head) storePut(&key, status[l], &b);
+            }
+            reportSolve(status[l], &b, shared);
+        } else {
+            uint64_t s0 = nowNs();
+            solvePuzzle(jobs[l], deduced[l], thread_num);
+            cost += (nowNs() - s0) / 1e9;
+        }
+        if (lat) lat[l] = status[l] >= 0 ? shared : shared + g_elapsed;
+        if (wall) wall[l] = cost;
+    }
+    statSet(&g_in_flight, 0);
+    return count;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Solves the next puzzle of a batch, or the next lockstep
+                group of them when g_lockstep is set; counts its
+                solutions instead in count mode
+ * In arg:      jobs, count, thread_num, lat, wall    See solveGroup
+ * Return val:  Number of puzzles consumed
+ */
+int solveNext(grid *jobs, int count, int thread_num, double *lat,
+              double *wall) {
+    if (g_lockstep && !g_count_cap) {
+        return solveGroup(jobs, count, thread_num, lat, wall);
+    }
+
+    uint64_t t0 = nowNs();
+    if (g_count_cap) countPuzzle(jobs[0], thread_num);
+    else solvePuzzle(jobs[0], jobs[0], thread_num);
+    if (lat) lat[0] = g_elapsed;
+    if (wall) wall[0] = (nowNs() - t0) / 1e9;
+    return 1;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Parses one puzzle line of a batch file. Either one
+                character per cell ('1'-'9', then 'A'-'P' for 10-25, '0'
+                or '.' for empty) or, if the line has spaces or commas,
+                decimal numbers with 0 for empty
+ * In arg:      line          Text of the line
+ * Out arg:     g             Parsed puzzle
+ * Return val:  A bool which is true if the line held exactly n * n cells
+ */
+bool parsePuzzle(const char *line, uint8_t *g) {
+    int n = 0;
+    if (strpbrk(line, " ,\t")) {
+        char *end;
+        for (;;) {
+            while (' ' == *line || ',' == *line || '\t' == *line) line++;
+            long v = strtol(line, &end, 10);
+            if (end == line) break;
+            if (n == g_geo.cells || v < 0 || v > MAXN) return 0;
+            g[n++] = v;
+            line = end;
+        }
+        return g_geo.cells == n && ('\0' == *line || '\n' == *line
+                                    || '\r' == *line);
+    }
+    for (; *line; line++) {
+        int v;
+        if (*line >= '0' && *line <= '9') v = *line - '0';
+        else if (*line >= 'A' && *line <= 'P') v = *line - 'A' + 10;
+        else if (*line >= 'a' && *line <= 'p') v = *line - 'a' + 10;
+        else if ('.' == *line) v = 0;
+        else continue;
+        if (n == g_geo.cells) return 0;
+        g[n++] = v;
+    }
+    return g_geo.cells == n;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Reads all puzzles of a batch file, skipping blank lines
+                and lines starting with '#'
+ * In arg:      path      Batch file, one puzzle per line
+ * Out arg:     count     Number of puzzles read
+ * Return val:  Array of puzzles, NULL if the file could not be read or
+                no memory is left
+ */
+grid *readBatch(const char *path, int *count) {
+    FILE *f = fopen(path, "r");
+    if (NULL == f) {
+        perror(path);
+        return NULL;
+    }
+    int cap = 64;
+    grid *list = malloc(cap * sizeof(grid));
+    char line[8 * MAXCELLS];
+    *count = 0;
+    while (list && fgets(line, sizeof(line), f)) {
+        if ('#' == line[0] || '\n' == line[0]) continue;
+        if (*count == cap) {
+            cap *= 2;
+            grid *more = realloc(list, cap * sizeof(grid));
+            if (NULL == more) free(list);
+            list = more;
+            if (NULL == list) break;
+        }
+        if (parsePuzzle(line, list[*count])) (*count)++;
+        else fprintf(stderr, "%s: skipping malformed line: %s", path, line);
+    }
+    if (NULL == list) perror(path);
+    fclose(f);
+    return list;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Converts a full board to the packed solution format, see
+                the -E option
+ * In arg:      b         Full board
+ * Out arg:     out       g_enum.rec bytes
+ */
+void packBoard(const board *b, uint8_t *out) {
+    memset(out, 0, g_enum.rec);
+    for (int cell = 0, at = 0; cell < g_geo.cells; cell++, at += g_enum.bits) {
+        unsigned v = b->cell[cell] - 1;
+        out[at >> 3] |= v << (at & 7);
+        if ((at & 7) + g_enum.bits > 8) out[(at >> 3) + 1] |= v >> (8 - (at & 7));
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Converts a packed solution back to a board
+ * In arg:      in        g_enum.rec bytes written by packBoard
+ * Out arg:     b         Full board
+ */
+void unpackBoard(const uint8_t *in, board *b) {
+    const unsigned m = (1u << g_enum.bits) - 1;
+    memset(b, 0, sizeof(*b));
+    for (int cell = 0, at = 0; cell < g_geo.cells; cell++, at += g_enum.bits) {
+        unsigned v = in[at >> 3] >> (at & 7);
+        if ((at & 7) + g_enum.bits > 8) v |= in[(at >> 3) + 1] << (8 - (at & 7));
+        placeAt(b, cell, (v & m) + 1);
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Writes the state of the enumeration to the checkpoint
+                file, replacing it atomically once the output it refers
+                to is on disk. Called with g_enum.lock held
+ * Return val:  0 on success, -1 if the checkpoint could not be written
+ */
+int enumCheckpoint(void) {
+    if (g_enum.fd >= 0 && 0 != fdatasync(g_enum.fd)) {
+        perror("fdatasync");
+        return -1;
+    }
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", g_enum.checkpoint);
+    FILE *f = fopen(tmp, "w");
+    if (NULL == f) {
+        perror(tmp);
+        return -1;
+    }
+    fprintf(f, "sudoku-enum %d\nbox %d\npuzzle ", CHECKPOINT_VERSION,
+            g_geo.box);
+    for (int c = 0; c < g_geo.cells; c++) {
+        fprintf(f, "%s%d", c ? "," : "", g_enum.puzzle[c]);
+    }
+    fprintf(f, "\nsubtrees %d\noffset %llu\nsolutions %llu\ndone ",
+            g_frontier.count, (unsigned long long)g_enum.offset,
+            (unsigned long long)g_enum.solutions);
+    for (int i = 0; i < g_frontier.count; i++) {
+        fputc(g_enum.done[i] ? '1' : '0', f);
+    }
+    fputc('\n', f);
+    // Resuming skips what a partly written subtree already produced
+    for (int i = 0; i < g_frontier.count; i++) {
+        if (!g_enum.done[i] && g_enum.written[i]) {
+            fprintf(f, "partial %d %llu\n", i,
+                    (unsigned long long)g_enum.written[i]);
+        }
+    }
+    if (0 != fflush(f) || 0 != fsync(fileno(f)) || 0 != fclose(f)
+        || 0 != rename(tmp, g_enum.checkpoint)) {
+        perror(g_enum.checkpoint);
+        return -1;
+    }
+    g_enum.saved = nowNs();
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Loads a checkpoint written by enumCheckpoint into g_enum
+ * In arg:      puzzle    Puzzle being enumerated; must match the file
+ * Return val:  1 if resumed, 0 if there is no checkpoint yet, -1 if it
+                belongs to another puzzle or is unreadable
+ */
+int enumResume(const uint8_t *puzzle) {
+    FILE *f = fopen(g_enum.checkpoint, "r");
+    if (NULL == f) {
+        if (ENOENT == errno) return 0;
+        perror(g_enum.checkpoint);
+        return -1;
+    }
+    char line[ENUM_SPLIT + 8 * MAXCELLS];
+    int version = 0, box = 0, subtrees = -1, i;
+    unsigned long long v;
+    grid saved;
+    bool same = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (1 == sscanf(line, "sudoku-enum %d", &version)) continue;
+        if (1 == sscanf(line, "box %d", &box)) continue;
+        if (1 == sscanf(line, "subtrees %d", &subtrees)) continue;
+        if (1 == sscanf(line, "offset %llu", &v)) g_enum.offset = v;
+        else if (1 == sscanf(line, "solutions %llu", &v)) g_enum.solutions = v;
+        else if (2 == sscanf(line, "partial %d %llu", &i, &v)) {
+            if (i >= 0 && i < g_frontier.count) g_enum.written[i] = v;
+        } else if (0 == strncmp(line, "puzzle ", 7)) {
+            same = parsePuzzle(line + 7, saved)
+                   && 0 == memcmp(saved, puzzle, g_geo.cells);
+        } else if (0 == strncmp(line, "done ", 5)) {
+            for (i = 0; i < g_frontier.count && '\n' != line[5 + i]
+                        && '\0' != line[5 + i]; i++) {
+                g_enum.done[i] = '1' == line[5 + i];
+            }
+        }
+    }
+    fclose(f);
+    if (CHECKPOINT_VERSION != version || box != g_geo.box || !same
+        || subtrees != g_frontier.count) {
+        fprintf(stderr, "%s: checkpoint of another puzzle or version\n",
+                g_enum.checkpoint);
+        return -1;
+    }
+    return 1;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Appends the solutions a worker holds back to the output
+                and accounts them to its subtree
+ * In arg:      o         Output of the calling worker
+                done      The subtree is finished
+ */
+void enumFlush(enum_out *o, bool done) {
+    mtxLock(&g_enum.lock);
+    size_t off = 0;
+    while (off < o->len && !g_enum.failed) {
+        ssize_t k = g_enum.fd >= 0
+                  ? write(g_enum.fd, o->buf + off, o->len - off)
+                  : send(sockfd, o->buf + off, o->len - off, MSG_NOSIGNAL);
+        if (k > 0) off += k;
+        else if (EINTR != errno) {
+            perror("enumeration output");
+            g_enum.failed = 1;
+        }
+    }
+    if (!g_enum.failed) {
+        uint64_t n = o->len / g_enum.rec;
+        if (0 == g_enum.solutions && n) unpackBoard(o->buf, &g_first);
+        g_enum.offset += o->len;
+        g_enum.solutions += n;
+        g_enum.written[o->sub] += n;
+        if (done) g_enum.done[o->sub] = 1;
+        if (g_enum.checkpoint
+            && nowNs() - g_enum.saved > CHECKPOINT_SECONDS * 1000000000ull) {
+            enumCheckpoint();
+        }
+    }
+    o->len = 0;
+    mtxUnlock(&g_enum.lock);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Emits every solution below a board in a fixed order (most
+                constrained cell first, digits ascending), so that a
+                resumed run can skip exactly the ones already written
+ * In arg:      b         Board, restored on return
+                o         Output of the calling worker
+ */
+void enumKernel(board *b, enum_out *o) {
+    t_nodes++;
+    if (__atomic_load_n(&g_enum.failed, __ATOMIC_RELAXED)) return;
+
+    mask_t cands;
+    int cell = pickCell(b, &cands);
+    if (cell < 0) {
+        if (o->skip) {
+            o->skip--;
+            return;
+        }
+        packBoard(b, o->buf + o->len);
+        o->len += g_enum.rec;
+        if (o->len + g_enum.rec > ENUM_BUFFER) enumFlush(o, 0);
+        return;
+    }
+    while (cands) {
+        int v = __builtin_ctz(cands);
+        cands &= cands - 1;
+        placeAt(b, cell, v);
+        enumKernel(b, o);
+        clearAt(b, cell, v);
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Each thread enumerates the subtrees it claims from
+                g_frontier, skipping those a checkpoint marks done
+ * In arg:      boardz structure, board used as scratch
+ * Return val:  Ignored
+ */
+void *enumSudoku(void *params) {
+    boardz *data = (boardz *) params;
+    workerEnter(data->id);
+    uint64_t s0 = nowNs();
+    PROBE2(search__start, g_solve_seq, data->id);
+
+    enum_out o;
+    o.buf = arenaAlloc(t_arena, ENUM_BUFFER, CACHELINE);
+    o.len = 0;
+    while (!__atomic_load_n(&g_enum.failed, __ATOMIC_RELAXED)
+           && (o.sub = frontierClaim(&g_frontier)) >= 0) {
+        if (g_enum.done[o.sub]) continue;
+        uint64_t t0 = traceNow();
+        o.skip = g_enum.written[o.sub];
+        data->board = *frontierAt(&g_frontier, o.sub);
+        enumKernel(&data->board, &o);
+        enumFlush(&o, 1);
+        traceSpan("subtree", t0, data->id);
+    }
+
+    PROBE3(search__end, g_solve_seq, data->id, t_nodes);
+    statAdd(&t_metrics->nodes, t_nodes);
+    statAdd(&t_metrics->busy_ns, nowNs() - s0);
+    traceRecord("exit", traceNow(), 0, data->id);
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Streams every solution of a puzzle to out in the packed
+                format. The tree is split into ENUM_SPLIT subtrees that
+                the workers share out; memory stays bounded by the
+                frontier and one ENUM_BUFFER per worker. With a
+                checkpoint file the run resumes where the last one
+                stopped, truncating output written after its checkpoint
+ * In arg:      puzzle        Cells of the Sudoku problem, see grid
+                thread_num    Number of worker threads
+                out           Output file, "-" for the server socket
+ * Return val:  Process exit code
+ */
+int enumPuzzle(const uint8_t *puzzle, int thread_num, const char *out) {
+
+    g_solve_seq++;
+    statSet(&g_in_flight, 1);
+    PROBE2(solve__start, g_solve_seq, thread_num);
+    for (int i = 0; i <= thread_num; i++) {
+        arenaReset(&g_arenas[i]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &g_start);
+
+    board start;
+    if (!boardLoad(&start, puzzle)) {
+        fprintf(stderr, "invalid puzzle\n");
+        return 1;
+    }
+    frontierSplit(&g_frontier, &start, ENUM_SPLIT);
+    int count = g_frontier.count;
+    g_enum.bits = 32 - __builtin_clz(g_geo.n - 1);
+    g_enum.rec = (g_geo.cells * g_enum.bits + 7) / 8;
+    g_enum.puzzle = puzzle;
+    g_enum.done = arenaAlloc(t_arena, count + 1, 1);
+    g_enum.written = arenaAlloc(t_arena, (count + 1) * sizeof(uint64_t),
+                                sizeof(uint64_t));
+    memset(g_enum.done, 0, count + 1);
+    memset(g_enum.written, 0, (count + 1) * sizeof(uint64_t));
+    int resumed = g_enum.checkpoint ? enumResume(puzzle) : 0;
+    if (resumed < 0) return 1;
+
+    if (0 != strcmp(out, "-")) {
+        g_enum.fd = open(out, O_RDWR | O_CREAT, 0644);
+        off_t size = g_enum.fd < 0 ? 0 : lseek(g_enum.fd, 0, SEEK_END);
+        if (g_enum.fd < 0 || size < (off_t)g_enum.offset
+            || 0 != ftruncate(g_enum.fd, g_enum.offset)
+            || lseek(g_enum.fd, 0, SEEK_END) != (off_t)g_enum.offset) {
+            fprintf(stderr, "%s: cannot %s output\n", out,
+                    resumed ? "resume" : "create");
+            return 1;
+        }
+        // The unique solution is reported, even if an earlier run found it
+        uint8_t first[MAXCELLS];
+        if (g_enum.solutions && g_enum.rec != (size_t)pread(g_enum.fd,
+                                 first, g_enum.rec, 0)) {
+            perror(out);
+            return 1;
+        }
+        if (g_enum.solutions) unpackBoard(first, &g_first);
+    }
+    if (resumed) {
+        fprintf(stderr, "resuming after %llu solutions\n",
+                (unsigned long long)g_enum.solutions);
+    }
+    g_enum.saved = nowNs();
+
+    boardz *p[thread_num];
+    pthread_t t[thread_num];
+    for (int i = 0; i < thread_num; i++) {
+        p[i] = (boardz *) arenaAlloc(&g_arenas[i + 1], sizeof(boardz),
+                                     CACHELINE);
+        p[i]->id = i;
+        uint64_t t0 = traceNow();
+        pthread_create(&t[i], NULL, enumSudoku, (void *) p[i]);
+        traceSpan("spawn", t0, i);
+    }
+    for (int i = 0; i < thread_num; i++) {
+        pthread_join(t[i], NULL);
+    }
+    if (g_enum.checkpoint && !g_enum.failed) enumCheckpoint();
+    if (g_enum.fd >= 0) close(g_enum.fd);
+
+    clock_gettime(CLOCK_MONOTONIC, &g_finish);
+    g_elapsed = (g_finish.tv_sec - g_start.tv_sec);
+    g_elapsed += (double)(g_finish.tv_nsec - g_start.tv_nsec) / 1000000000;
+    g_status = 0 == g_enum.solutions ? ST_UNSOLVABLE
+             : 1 == g_enum.solutions ? ST_UNIQUE : ST_MULTIPLE;
+    metricsSolve(g_status, g_elapsed);
+    PROBE3(solve__end, g_solve_seq, g_status, (uint64_t)(g_elapsed * 1e9));
+    statSet(&g_in_flight, 0);
+
+    fprintf(stderr, "%llu solutions of %zu bytes in %f s\n",
+            (unsigned long long)g_enum.solutions, g_enum.rec, g_elapsed);
+    // A socket stream carries the solutions only
+    if (g_enum.fd >= 0 && sockfd >= 0) {
+        char *b1 = buffCount(g_status, g_enum.solutions, &g_first, g_elapsed);
+        send(sockfd , b1 , strlen(b1) , 0 );
+    }
+    return g_enum.failed ? 1 : 0;
+}
+
+
+
+/*-------------------------------------------------------------------
+ * Purpose:     xorshift64* generator; cheap and private to its caller,
+                unlike rand()
+ * In arg:      state     Generator state, must not be 0
+ * Return val:  Next pseudo random value
+ */
+static inline uint64_t rngNext(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+int cmpDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Tests whether two cells share a unit
+ * In arg:      a, b      Indices of the cells
+ * Return val:  A bool which is true if a and b are distinct peers
+ */
+bool isPeer(int a, int b) {
+    const uint8_t *ua = g_geo.unitOf[a], *ub = g_geo.unitOf[b];
+    return a != b && (ua[0] == ub[0] || ua[1] == ub[1] || ua[2] == ub[2]);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Places a digit and removes it from the candidates of
+                every peer
+ * In arg:      g         Candidate grid
+                cell      Open cell
+                v         Digit, must be a candidate of cell
+ */
+void cgPlace(cgrid *g, int cell, int v) {
+    const mask_t bit = (mask_t)1 << v;
+    if (!(g->cand[cell] & bit)) {
+        g->broken = 1;
+        return;
+    }
+    g->val[cell] = v;
+    g->cand[cell] = bit;
+    g->open--;
+    const uint16_t *peer = &g_geo.peers[cell * g_geo.npeers];
+    for (int k = 0; k < g_geo.npeers; k++) {
+        g->cand[peer[k]] &= ~bit;
+        if (0 == g->cand[peer[k]]) g->broken = 1;
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Removes candidates from an open cell
+ * In arg:      g         Candidate grid
+                cell      Index of the cell
+                m         Digits to remove
+ * Return val:  1 if a candidate went away, else 0
+ */
+int cgElim(cgrid *g, int cell, mask_t m) {
+    if (g->val[cell] || !(g->cand[cell] & m)) return 0;
+    g->cand[cell] &= ~m;
+    if (0 == g->cand[cell]) g->broken = 1;
+    return 1;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Builds the candidate grid of a board
+ * In arg:      b         Board, givens only
+ * Out arg:     g         Grid with the givens placed
+ */
+void cgLoad(cgrid *g, const board *b) {
+    const mask_t all = (((mask_t)1 << g_geo.n) - 1) << 1;
+    for (int c = 0; c < g_geo.cells; c++) {
+        g->cand[c] = all;
+        g->val[c] = 0;
+    }
+    g->open = g_geo.cells;
+    g->broken = 0;
+    for (int c = 0; c < g_geo.cells; c++) {
+        if (b->cell[c]) cgPlace(g, c, b->cell[c]);
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Techniques of the rating ladder. Each applies every
+                instance it finds in one sweep over the grid
+ * In arg:      g         Candidate grid
+ * Return val:  1 if a digit was placed or a candidate removed, else 0
+ */
+int nakedSingle(cgrid *g) {
+    int progress = 0;
+    for (int c = 0; c < g_geo.cells && !g->broken; c++) {
+        mask_t m = g->cand[c];
+        if (0 == g->val[c] && m && !(m & (m - 1))) {
+            cgPlace(g, c, __builtin_ctz(m));
+            progress = 1;
+        }
+    }
+    return progress;
+}
+
+int hiddenSingle(cgrid *g) {
+    const int n = g_geo.n;
+    const mask_t all = (((mask_t)1 << n) - 1) << 1;
+    int progress = 0;
+    for (int u = 0; u < 3 * n && !g->broken; u++) {
+        const uint16_t *cells = &g_geo.unitCells[u * n];
+        mask_t once = 0, twice = 0, placed = 0;
+        for (int k = 0; k < n; k++) {
+            mask_t m = g->cand[cells[k]];
+            if (g->val[cells[k]]) {
+                placed |= m;
+                continue;
+            }
+            twice |= once & m;
+            once |= m;
+        }
+        if ((once | placed) != all) g->broken = 1;
+        for (mask_t hit = once & ~twice & ~placed; hit; hit &= hit - 1) {
+            int v = __builtin_ctz(hit);
+            for (int k = 0; k < n; k++) {
+                if (0 == g->val[cells[k]] && (g->cand[cells[k]] >> v & 1)) {
+                    cgPlace(g, cells[k], v);
+                    progress = 1;
+                    break;
+                }
+            }
+        }
+    }
+    return progress;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Locked candidates: a digit whose places in a box lie in
+                one line leaves the rest of that line (pointing), and one
+                whose places in a line lie in one box leaves the rest of
+                that box (claiming)
+ * In arg:      g         Candidate grid
+                claiming  0 for pointing, 1 for claiming
+ * Return val:  1 if a candidate was removed, else 0
+ */
+int lockedCandidates(cgrid *g, bool claiming) {
+    const int n = g_geo.n;
+    int progress = 0;
+    for (int u = claiming ? 0 : 2 * n; u < (claiming ? 2 * n : 3 * n); u++) {
+        const uint16_t *cells = &g_geo.unitCells[u * n];
+        for (int v = 1; v <= n; v++) {
+            // Row, column and box shared by all places of v, -1 if not
+            int shared[3] = { -1, -1, -1 };
+            int places = 0;
+            for (int k = 0; k < n; k++) {
+                const uint8_t *uc = g_geo.unitOf[cells[k]];
+                if (g->val[cells[k]] || !(g->cand[cells[k]] >> v & 1)) continue;
+                for (int t = 0; t < 3; t++) {
+                    if (0 == places) shared[t] = uc[t];
+                    else if (shared[t] != uc[t]) shared[t] = -1;
+                }
+                places++;
+            }
+            if (places < 2) continue;
+            for (int t = claiming ? 2 : 0; t < (claiming ? 3 : 2); t++) {
+                if (shared[t] < 0) continue;
+                const uint16_t *line = &g_geo.unitCells[shared[t] * n];
+                for (int k = 0; k < n; k++) {
+                    const uint8_t *uo = g_geo.unitOf[line[k]];
+                    if (uo[0] != u && uo[1] != u && uo[2] != u) {
+                        progress |= cgElim(g, line[k], (mask_t)1 << v);
+                    }
+                }
+            }
+        }
+    }
+    return progress;
+}
+
+int pointing(cgrid *g) {
+    return lockedCandidates(g, 0);
+}
+
+int claiming(cgrid *g) {
+    return lockedCandidates(g, 1);
+}
+
+/* Called for k sets whose union has exactly k elements */
+typedef int (*subset_fn)(cgrid *g, const int *idx, uint32_t pick, mask_t uni,
+                         int arg);
+
+/*-------------------------------------------------------------------
+ * Purpose:     Finds every choice of k sets whose union has k elements,
+                the pattern behind naked and hidden subsets and fish
+ * In arg:      sets      Non-empty sets
+                m         Number of sets
+                k         Size of the pattern
+                from      First set still to choose from
+                pick      Sets chosen so far, bit i for sets[i]
+                uni       Their union
+                hit       Applies a pattern found
+                g, idx, arg   Passed on to hit
+ * Return val:  1 if hit removed a candidate, else 0
+ */
+int subsetFind(const mask_t *sets, int m, int k, int from, uint32_t pick,
+               mask_t uni, subset_fn hit, cgrid *g, const int *idx, int arg) {
+    int chosen = __builtin_popcount(pick);
+    if (chosen == k) return hit(g, idx, pick, uni, arg);
+    int progress = 0;
+    for (int i = from; i <= m - (k - chosen); i++) {
+        mask_t u = uni | sets[i];
+        if (__builtin_popcount(u) > k) continue;
+        progress |= subsetFind(sets, m, k, i + 1, pick | 1u << i, u, hit, g,
+                               idx, arg);
+    }
+    return progress;
+}
+
+/* k cells of unit arg holding only k digits: the rest of the unit loses
+   those digits. idx maps a set to its position in the unit */
+int nakedHit(cgrid *g, const int *idx, uint32_t pick, mask_t uni, int arg) {
+    const uint16_t *cells = &g_geo.unitCells[arg * g_geo.n];
+    uint32_t in = 0;
+    for (uint32_t p = pick; p; p &= p - 1) in |= 1u << idx[__builtin_ctz(p)];
+    int progress = 0;
+    for (int k = 0; k < g_geo.n; k++) {
+        if (!(in >> k & 1)) progress |= cgElim(g, cells[k], uni);
+    }
+    return progress;
+}
+
+/* k digits of unit arg confined to k cells: those cells lose every other
+   digit. Sets are positions in the unit, idx maps a set to its digit */
+int hiddenHit(cgrid *g, const int *idx, uint32_t pick, mask_t uni, int arg) {
+    const uint16_t *cells = &g_geo.unitCells[arg * g_geo.n];
+    mask_t digits = 0;
+    for (uint32_t p = pick; p; p &= p - 1) {
+        digits |= (mask_t)1 << idx[__builtin_ctz(p)];
+    }
+    int progress = 0;
+    for (mask_t u = uni; u; u &= u - 1) {
+        progress |= cgElim(g, cells[__builtin_ctz(u)], ~digits);
+    }
+    return progress;
+}
+
+/* Digit arg % 32 confined to k cover lines in k base lines: the cover
+   lines lose it everywhere else. Base lines are rows if arg < 32, else
+   columns; idx maps a set to its base line, sets hold cover lines */
+int fishHit(cgrid *g, const int *idx, uint32_t pick, mask_t uni, int arg) {
+    const int n = g_geo.n, v = arg % 32;
+    const bool rows = arg < 32;
+    uint32_t base = 0;
+    for (uint32_t p = pick; p; p &= p - 1) base |= 1u << idx[__builtin_ctz(p)];
+    int progress = 0;
+    for (mask_t u = uni; u; u &= u - 1) {
+        int cover = __builtin_ctz(u);
+        for (int b = 0; b < n; b++) {
+            if (base >> b & 1) continue;
+            int c = rows ? b * n + cover : cover * n + b;
+            progress |= cgElim(g, c, (mask_t)1 << v);
+        }
+    }
+    return progress;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Naked and hidden subsets of size k in every unit
+ * In arg:      g         Candidate grid
+                k         2 for pairs, 3 for triples, 4 for quads
+                hidden    0 for naked, 1 for hidden subsets
+ * Return val:  1 if a candidate was removed, else 0
+ */
+int subsets(cgrid *g, int k, bool hidden) {
+    const int n = g_geo.n;
+    int progress = 0;
+    for (int u = 0; u < 3 * n && !g->broken; u++) {
+        const uint16_t *cells = &g_geo.unitCells[u * n];
+        mask_t sets[MAXN];
+        int idx[MAXN], m = 0;
+        if (!hidden) {
+            for (int p = 0; p < n; p++) {
+                if (g->val[cells[p]]) continue;
+                sets[m] = g->cand[cells[p]];
+                idx[m++] = p;
+            }
+        } else {
+            for (int v = 1; v <= n; v++) {
+                mask_t where = 0;
+                for (int p = 0; p < n; p++) {
+                    if (g->cand[cells[p]] >> v & 1) where |= (mask_t)1 << p;
+                }
+                bool placed = 0;
+                for (int p = 0; p < n; p++) placed |= g->val[cells[p]] == v;
+                if (placed || 0 == where) continue;
+                sets[m] = where;
+                idx[m++] = v;
+            }
+        }
+        progress |= subsetFind(sets, m, k, 0, 0, 0,
+                               hidden ? hiddenHit : nakedHit, g, idx, u);
+    }
+    return progress;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Basic fish of size k (X-Wing, Swordfish, Jellyfish) for
+                every digit, rows and columns as base lines
+ * In arg:      g         Candidate grid
+                k         2, 3 or 4
+ * Return val:  1 if a candidate was removed, else 0
+ */
+int fish(cgrid *g, int k) {
+    const int n = g_geo.n;
+    int progress = 0;
+    for (int v = 1; v <= n && !g->broken; v++) {
+        for (int rows = 1; rows >= 0; rows--) {
+            mask_t sets[MAXN];
+            int idx[MAXN], m = 0;
+            for (int b = 0; b < n; b++) {
+                mask_t where = 0;
+                bool placed = 0;
+                for (int x = 0; x < n; x++) {
+                    int c = rows ? b * n + x : x * n + b;
+                    placed |= g->val[c] == v;
+                    if (!g->val[c] && (g->cand[c] >> v & 1)) {
+                        where |= (mask_t)1 << x;
+                    }
+                }
+                if (placed || 0 == where) continue;
+                sets[m] = where;
+                idx[m++] = b;
+            }
+            progress |= subsetFind(sets, m, k, 0, 0, 0, fishHit, g, idx,
+                                   rows ? v : 32 + v);
+        }
+    }
+    return progress;
+}
+
+int nakedPair(cgrid *g) { return subsets(g, 2, 0); }
+int hiddenPair(cgrid *g) { return subsets(g, 2, 1); }
+int nakedTriple(cgrid *g) { return subsets(g, 3, 0); }
+int hiddenTriple(cgrid *g) { return subsets(g, 3, 1); }
+int nakedQuad(cgrid *g) { return subsets(g, 4, 0); }
+int hiddenQuad(cgrid *g) { return subsets(g, 4, 1); }
+int xWing(cgrid *g) { return fish(g, 2); }
+int swordfish(cgrid *g) { return fish(g, 3); }
+int jellyfish(cgrid *g) { return fish(g, 4); }
+
+/*-------------------------------------------------------------------
+ * Purpose:     XY-Wing: a pivot {x,y} seeing pincers {x,z} and {y,z};
+                whichever digit the pivot takes, one pincer is z, so
+                cells seeing both pincers lose z
+ * In arg:      g         Candidate grid
+ * Return val:  1 if a candidate was removed, else 0
+ */
+int xyWing(cgrid *g) {
+    const int np = g_geo.npeers;
+    int progress = 0;
+    for (int pv = 0; pv < g_geo.cells; pv++) {
+        mask_t m = g->cand[pv];
+        if (g->val[pv] || 2 != __builtin_popcount(m)) continue;
+        const uint16_t *peer = &g_geo.peers[pv * np];
+        for (int i = 0; i < np; i++) {
+            mask_t a = g->cand[peer[i]];
+            if (g->val[peer[i]] || 2 != __builtin_popcount(a)
+                || 1 != __builtin_popcount(a & m)) continue;
+            mask_t z = a & ~m;
+            for (int j = 0; j < np; j++) {
+                if (g->cand[peer[j]] != ((m & ~a) | z) || g->val[peer[j]]) {
+                    continue;
+                }
+                const uint16_t *seen = &g_geo.peers[peer[i] * np];
+                for (int k = 0; k < np; k++) {
+                    if (seen[k] != peer[j] && isPeer(seen[k], peer[j])) {
+                        progress |= cgElim(g, seen[k], z);
+                    }
+                }
+            }
+        }
+    }
+    return progress;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Forcing chain by contradiction: a candidate whose
+                placement leads, through singles alone, to a cell or unit
+                without candidates is removed
+ * In arg:      g         Candidate grid
+ * Return val:  1 if a candidate was removed, else 0
+ */
+int forcingChain(cgrid *g) {
+    for (int c = 0; c < g_geo.cells; c++) {
+        if (g->val[c]) continue;
+        for (mask_t m = g->cand[c]; m; m &= m - 1) {
+            int v = __builtin_ctz(m);
+            cgrid t = *g;
+            cgPlace(&t, c, v);
+            while (!t.broken && (nakedSingle(&t) | hiddenSingle(&t)));
+            if (t.broken) return cgElim(g, c, (mask_t)1 << v);
+        }
+    }
+    return 0;
+}
+
+/* The ladder, easiest first; scores follow Sudoku Explainer */
+const technique g_ladder[] = {
+    { "hidden-single", 1.5, hiddenSingle },
+    { "naked-single", 2.3, nakedSingle },
+    { "pointing", 2.6, pointing },
+    { "claiming", 2.8, claiming },
+    { "naked-pair", 3.0, nakedPair },
+    { "x-wing", 3.2, xWing },
+    { "hidden-pair", 3.4, hiddenPair },
+    { "naked-triple", 3.6, nakedTriple },
+    { "swordfish", 3.8, swordfish },
+    { "hidden-triple", 4.0, hiddenTriple },
+    { "xy-wing", 4.2, xyWing },
+    { "naked-quad", 5.0, nakedQuad },
+    { "jellyfish", 5.2, jellyfish },
+    { "hidden-quad", 5.4, hiddenQuad },
+    { "forcing-chain", 7.5, forcingChain },
+    { "trial-and-error", 10.0, NULL },
+};
+
+/*-------------------------------------------------------------------
+ * Purpose:     Rates a puzzle by solving it the way a person would:
+                always with the easiest technique of g_ladder that makes
+                progress, starting over from the easiest after each step
+ * In arg:      p         Puzzle
+ * Return val:  Index in g_ladder of the hardest technique needed; -1 if
+                the puzzle turned out to have no solution
+ */
+int ratePuzzle(const board *p) {
+    cgrid g;
+    cgLoad(&g, p);
+    int hardest = 0;
+    while (g.open > 0 && !g.broken) {
+        int t = 0;
+        while (g_ladder[t].fn && !g_ladder[t].fn(&g)) t++;
+        if (t > hardest) hardest = t;
+        if (NULL == g_ladder[t].fn) break;
+    }
+    return g.broken ? -1 : hardest;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Each thread rates the puzzles of g_rate it claims
+ * In arg:      boardz structure, board used as scratch
+ * Return val:  Ignored
+ */
+void *rateSudoku(void *params) {
+    boardz *data = (boardz *) params;
+    workerEnter(data->id);
+    uint64_t s0 = nowNs();
+    int i;
+    while ((i = __atomic_fetch_add(&g_rate.next, 1, __ATOMIC_RELAXED))
+           < g_rate.count) {
+        uint64_t t0 = traceNow();
+        g_rate.hardest[i] = boardLoad(&data->board, g_rate.jobs[i])
+                          ? ratePuzzle(&data->board) : -2;
+        traceSpan("rate", t0, g_rate.hardest[i]);
+    }
+    statAdd(&t_metrics->busy_ns, nowNs() - s0);
+    traceRecord("exit", traceNow(), 0, data->id);
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Rates a batch on thread_num workers; prints one "score
+                technique" line per puzzle in input order to stdout and
+                a summary to stderr
+ * In arg:      jobs          Puzzles
+                count         Number of puzzles
+                thread_num    Number of worker threads
+ * Return val:  Process exit code
+ */
+int ratePuzzles(grid *jobs, int count, int thread_num) {
+    g_rate.jobs = jobs;
+    g_rate.count = count;
+    g_rate.next = 0;
+    g_rate.hardest = malloc(count * sizeof(int));
+    if (NULL == g_rate.hardest && count > 0) {
+        perror("-R");
+        return 1;
+    }
+    uint64_t t0 = nowNs();
+
+    boardz *p[thread_num];
+    pthread_t t[thread_num];
+    for (int i = 0; i < thread_num; i++) {
+        p[i] = (boardz *) arenaAlloc(&g_arenas[i + 1], sizeof(boardz),
+                                     CACHELINE);
+        p[i]->id = i;
+        pthread_create(&t[i], NULL, rateSudoku, (void *) p[i]);
+    }
+    for (int i = 0; i < thread_num; i++) {
+        pthread_join(t[i], NULL);
+    }
+    double wall = (nowNs() - t0) / 1e9;
+
+    const int steps = sizeof(g_ladder) / sizeof(g_ladder[0]);
+    int uses[sizeof(g_ladder) / sizeof(g_ladder[0])] = { 0 };
+    for (int i = 0; i < count; i++) {
+        int h = g_rate.hardest[i];
+        if (h >= 0) {
+            printf("%.1f %s\n", g_ladder[h].score, g_ladder[h].name);
+            uses[h]++;
+        } else {
+            printf("0.0 %s\n", -1 == h ? "unsolvable" : "invalid");
+        }
+    }
+    fflush(stdout);
+    fprintf(stderr, "rated %d puzzles in %f s: %.1f puzzles/s\n", count,
+            wall, wall > 0 ? count / wall : 0);
+    for (int h = 0; h < steps; h++) {
+        if (uses[h]) fprintf(stderr, "%5.1f %-16s %d\n", g_ladder[h].score,
+                             g_ladder[h].name, uses[h]);
+    }
+    free(g_rate.hardest);
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Completes a board by depth-first search, most constrained
+                cell first
+ * In arg:      b         Board to complete
+                rng       Generator state to try digits in random order,
+                          NULL for ascending order
+ * Out arg:     b         Completed board if a solution exists, else
+                          unchanged
+ * Return val:  A bool which is true if a solution was found
+ */
+bool fillKernel(board *b, uint64_t *rng) {
+    t_nodes++;
+    mask_t cands;
+    int cell = pickCell(b, &cands);
+    if (cell < 0) return 1;
+
+    int vals[MAXN], k = 0;
+    while (cands) {
+        vals[k++] = __builtin_ctz(cands);
+        cands &= cands - 1;
+    }
+    for (int i = k - 1; rng && i > 0; i--) {
+        int j = rngNext(rng) % (i + 1), v = vals[i];
+        vals[i] = vals[j];
+        vals[j] = v;
+    }
+    for (int i = 0; i < k; i++) {
+        placeAt(b, cell, vals[i]);
+        if (fillKernel(b, rng)) return 1;
+        clearAt(b, cell, vals[i]);
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Cells that a clue symmetry ties to a given cell
+ * In arg:      cell      Index of the cell, row by row
+                sym       One of SYM_*
+ * Out arg:     orbit     The cell and its images, without repeats
+ * Return val:  Number of cells in orbit, 1 to 4
+ */
+int orbitOf(int cell, int sym, int orbit[4]) {
+    const int n = g_geo.n, r = cell / n, c = cell % n;
+    int img[4] = { cell, cell, cell, cell };
+    if (SYM_MIRROR == sym) img[1] = r * n + n - 1 - c;
+    if (SYM_180 == sym || SYM_90 == sym) {
+        img[1] = (n - 1 - r) * n + n - 1 - c;
+    }
+    if (SYM_90 == sym) {
+        img[2] = c * n + n - 1 - r;
+        img[3] = (n - 1 - c) * n + r;
+    }
+    int k = 0;
+    for (int i = 0; i < 4; i++) {
+        int j = 0;
+        while (j < k && orbit[j] != img[i]) j++;
+        if (j == k) orbit[k++] = img[i];
+    }
+    return k;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Checks that a puzzle is still unique after clues were
+                removed from it. The puzzle had the single solution sol,
+                so any other solution must differ from sol in a removed
+                cell: trying each other digit there is enough, and each
+                try is a plain satisfiability search
+ * In arg:      p         Puzzle with the cells removed
+                sol       Its known solution
+                cells     Removed cells
+                k         Number of removed cells
+ * Return val:  A bool which is true if sol is still the only solution
+ */
+bool stillUnique(const board *p, const board *sol, const int *cells, int k) {
+    const mask_t all = (((mask_t)1 << g_geo.n) - 1) << 1;
+    for (int i = 0; i < k; i++) {
+        mask_t cands = all & ~usedAt(p, cells[i])
+                     & ~((mask_t)1 << sol->cell[cells[i]]);
+        while (cands) {
+            int v = __builtin_ctz(cands);
+            cands &= cands - 1;
+            board t = *p;
+            placeAt(&t, cells[i], v);
+            if (fillKernel(&t, NULL)) return 0;
+        }
+    }
+    return 1;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Each thread makes puzzles until g_gen.count are claimed:
+                a random full grid, then clues removed in random order,
+                one symmetry orbit at a time, as long as the solution
+                stays unique. Puzzles above the clue target or outside
+                the difficulty band are thrown away
+ * In arg:      boardz structure, id picks the metrics slot and seeds
+                t_rng, see workerEnter
+ * Return val:  Ignored
+ */
+void *generateSudoku(void *params) {
+    boardz *data = (boardz *) params;
+    workerEnter(data->id);
+    uint64_t s0 = nowNs();
+    const int cells = g_geo.cells;
+
+    while (__atomic_fetch_add(&g_gen.next, 1, __ATOMIC_RELAXED) < g_gen.count) {
+        uint64_t t0 = traceNow();
+        board sol, p;
+        int clues = 0;
+        double rating = 0;
+        int tries = 0;
+        for (;;) {
+            if (++tries > GEN_ATTEMPTS
+                || __atomic_load_n(&g_gen.failed, __ATOMIC_RELAXED)) {
+                break;
+            }
+            __atomic_fetch_add(&g_gen.grids, 1, __ATOMIC_RELAXED);
+            memset(&sol, 0, sizeof(sol));
+            fillKernel(&sol, &t_rng);
+            p = sol;
+            clues = cells;
+
+            uint16_t order[MAXCELLS];
+            bool seen[MAXCELLS] = { 0 };
+            for (int i = 0; i < cells; i++) {
+                int j = rngNext(&t_rng) % (i + 1);
+                order[i] = order[j];
+                order[j] = i;
+            }
+            for (int i = 0; i < cells && clues > g_gen.clues; i++) {
+                int orbit[4];
+                if (seen[order[i]]) continue;
+                int k = orbitOf(order[i], g_gen.sym, orbit);
+                for (int j = 0; j < k; j++) {
+                    seen[orbit[j]] = 1;
+                    clearAt(&p, orbit[j], sol.cell[orbit[j]]);
+                }
+                if (stillUnique(&p, &sol, orbit, k)) {
+                    clues -= k;
+                    continue;
+                }
+                for (int j = 0; j < k; j++) {
+                    placeAt(&p, orbit[j], sol.cell[orbit[j]]);
+                }
+            }
+            if (g_gen.clues && clues > g_gen.clues) continue;
+
+            if (!g_gen.rated) break;
+            int hardest = ratePuzzle(&p);
+            if (hardest < 0) continue;
+            rating = g_ladder[hardest].score;
+            if (rating >= g_gen.dmin && rating <= g_gen.dmax) break;
+        }
+        if (tries > GEN_ATTEMPTS
+            || __atomic_load_n(&g_gen.failed, __ATOMIC_RELAXED)) {
+            if (!__atomic_exchange_n(&g_gen.failed, 1, __ATOMIC_RELAXED)) {
+                fprintf(stderr, "gave up after %d grids: none dug down to the "
+                        "-g clues or rated within the -D band\n",
+                        GEN_ATTEMPTS);
+            }
+            break;
+        }
+
+        char line[MAXCELLS + 2];
+        for (int c = 0; c < cells; c++) {
+            int v = p.cell[c];
+            line[c] = 0 == v ? '.' : v <= 9 ? '0' + v : 'A' + v - 10;
+        }
+        line[cells] = '\n';
+        line[cells + 1] = '\0';
+        pthread_mutex_lock(&g_gen.out);
+        fputs(line, stdout);
+        pthread_mutex_unlock(&g_gen.out);
+        __atomic_fetch_add(&g_gen.made, 1, __ATOMIC_RELAXED);
+        traceSpan("generate", t0, clues);
+        PROBE3(generate, data->id, clues, (int)(rating * 10));
+    }
+
+    statAdd(&t_metrics->nodes, t_nodes);
+    statAdd(&t_metrics->busy_ns, nowNs() - s0);
+    traceRecord("exit", traceNow(), 0, data->id);
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Generates g_gen.count puzzles with thread_num workers
+                and reports the throughput to stderr
+ * In arg:      thread_num    Number of worker threads
+ * Return val:  Process exit code; 1 if the -D band holds no score of
+                g_ladder or a puzzle took more than GEN_ATTEMPTS grids
+ */
+int generatePuzzles(int thread_num) {
+    bool reachable = !g_gen.rated;
+    for (int t = 0; g_gen.rated && t < (int)(sizeof(g_ladder)
+                                             / sizeof(g_ladder[0])); t++) {
+        reachable |= g_ladder[t].score >= g_gen.dmin
+                     && g_ladder[t].score <= g_gen.dmax;
+    }
+    if (!reachable) {
+        fprintf(stderr, "no technique is rated %g to %g, see -R\n",
+                g_gen.dmin, g_gen.dmax);
+        return 1;
+    }
+
+    struct timespec cpu0, cpu1;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu0);
+    uint64_t t0 = nowNs();
+
+    boardz *p[thread_num];
+    pthread_t t[thread_num];
+    for (int i = 0; i < thread_num; i++) {
+        p[i] = (boardz *) arenaAlloc(&g_arenas[i + 1], sizeof(boardz),
+                                     CACHELINE);
+        p[i]->id = i;
+        pthread_create(&t[i], NULL, generateSudoku, (void *) p[i]);
+    }
+    for (int i = 0; i < thread_num; i++) {
+        pthread_join(t[i], NULL);
+    }
+    fflush(stdout);
+
+    double wall = (nowNs() - t0) / 1e9;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu1);
+    double cpu = (cpu1.tv_sec - cpu0.tv_sec)
+               + (cpu1.tv_nsec - cpu0.tv_nsec) / 1e9;
+    fprintf(stderr, "generated %d unique puzzles from %llu grids in %f s: "
+            "%.1f puzzles/s, %.1f puzzles/s per core (%.3f CPU s, "
+            "symmetry %s)\n", g_gen.made,
+            (unsigned long long)g_gen.grids, wall,
+            wall > 0 ? g_gen.made / wall : 0,
+            cpu > 0 ? g_gen.made / cpu : 0, cpu, g_sym_names[g_gen.sym]);
+    return g_gen.failed;
+}
+
+/* Benchmark statistics compared against a baseline */
+enum { BS_THROUGHPUT, BS_P50, BS_P90, BS_P99, BS_COUNT };
+const char *g_bench_names[BS_COUNT] = { "throughput", "p50", "p90", "p99" };
+
+/*-------------------------------------------------------------------
+ * Purpose:     Computes the benchmark statistics of one sample
+ * In arg:      lat       Solve latencies in seconds
+                wall      Full cost of each solve (spawn to join), seconds
+                n         Number of solves
+                sorted    Scratch of n doubles, on the heap: a sample of
+                          puzzles x passes can outgrow the stack
+ * Out arg:     out       BS_COUNT statistics, throughput in solves/s
+ */
+void benchStats(const double *lat, const double *wall, int n,
+                double *sorted, double out[BS_COUNT]) {
+    double total = 0;
+    for (int i = 0; i < n; i++) {
+        sorted[i] = lat[i];
+        total += wall[i];
+    }
+    qsort(sorted, n, sizeof(double), cmpDouble);
+    out[BS_THROUGHPUT] = total > 0 ? n / total : 0;
+    out[BS_P50] = sorted[(int)(0.50 * (n - 1))];
+    out[BS_P90] = sorted[(int)(0.90 * (n - 1))];
+    out[BS_P99] = sorted[(int)(0.99 * (n - 1))];
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Bootstrap 95% confidence intervals of current/baseline
+                for every statistic, resampling both sides with
+                replacement
+ * In arg:      b_lat, b_wall, nb     Baseline sample
+                c_lat, c_wall, nc     Current sample
+ * Out arg:     lo, hi                Interval bounds per statistic
+ * Return val:  0 on success, -1 if no memory is left
+ */
+int bootstrapRatio(const double *b_lat, const double *b_wall, int nb,
+                    const double *c_lat, const double *c_wall, int nc,
+                    double lo[BS_COUNT], double hi[BS_COUNT]) {
+    double *ratio = malloc(BOOTSTRAP_ROUNDS * BS_COUNT * sizeof(double));
+    double *rl = malloc((nb > nc ? nb : nc) * sizeof(double));
+    double *rw = malloc((nb > nc ? nb : nc) * sizeof(double));
+    double *rs = malloc((nb > nc ? nb : nc) * sizeof(double));
+    if (NULL == ratio || NULL == rl || NULL == rw || NULL == rs) {
+        free(ratio);
+        free(rl);
+        free(rw);
+        free(rs);
+        return -1;
+    }
+    uint64_t rng = 0x9E3779B97F4A7C15ull; // fixed: reruns give equal CIs
+
+    for (int r = 0; r < BOOTSTRAP_ROUNDS; r++) {
+        double bs[BS_COUNT], cs[BS_COUNT];
+        for (int i = 0; i < nb; i++) {
+            int k = rngNext(&rng) % nb;
+            rl[i] = b_lat[k];
+            rw[i] = b_wall[k];
+        }
+        benchStats(rl, rw, nb, rs, bs);
+        for (int i = 0; i < nc; i++) {
+            int k = rngNext(&rng) % nc;
+            rl[i] = c_lat[k];
+            rw[i] = c_wall[k];
+        }
+        benchStats(rl, rw, nc, rs, cs);
+        for (int m = 0; m < BS_COUNT; m++) {
+            ratio[m * BOOTSTRAP_ROUNDS + r] = bs[m] > 0 ? cs[m] / bs[m] : 1;
+        }
+    }
+    for (int m = 0; m < BS_COUNT; m++) {
+        double *v = &ratio[m * BOOTSTRAP_ROUNDS];
+        qsort(v, BOOTSTRAP_ROUNDS, sizeof(double), cmpDouble);
+        lo[m] = v[(int)(0.025 * BOOTSTRAP_ROUNDS)];
+        hi[m] = v[(int)(0.975 * BOOTSTRAP_ROUNDS) - 1];
+    }
+    free(ratio);
+    free(rl);
+    free(rw);
+    free(rs);
+    return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Writes a benchmark sample as a versioned JSON baseline
+ * In arg:      path      Output file
+                corpus    Corpus the sample was taken on
+                threads   Workers per solve
+                lat, wall, n  Sample, see benchStats
+                sorted    Scratch of n doubles, see benchStats
+ * Return val:  0 on success, -1 if the file could not be written
+ */
+int benchWrite(const char *path, const char *corpus, int threads,
+               const double *lat, const double *wall, int n,
+               double *sorted) {
+    FILE *f = fopen(path, "w");
+    if (NULL == f) {
+        perror(path);
+        return -1;
+    }
+    double st[BS_COUNT];
+    benchStats(lat, wall, n, sorted, st);
+    fprintf(f, "{\n  \"version\": %d,\n  \"created\": %lld,\n"
+            "  \"corpus\": \"", BASELINE_VERSION, (long long)time(NULL));
+    // Paths may hold quotes, backslashes or control characters
+    for (const unsigned char *c = (const unsigned char *)corpus; *c; c++) {
+        if ('"' == *c || '\\' == *c) fprintf(f, "\\%c", *c);
+        else if (*c < 0x20) fprintf(f, "\\u%04x", *c);
+        else fputc(*c, f);
+    }
+    fprintf(f, "\",\n  \"threads\": %d,\n  \"solves\": %d,\n", threads, n);
+    for (int m = 0; m < BS_COUNT; m++) {
+        fprintf(f, "  \"%s\": %.9g,\n", g_bench_names[m], st[m]);
+    }
+    const char *keys[2] = { "latency", "wall" };
+    const double *arrays[2] = { lat, wall };
+    for (int a = 0; a < 2; a++) {
+        fprintf(f, "  \"%s\": [", keys[a]);
+        for (int i = 0; i < n; i++) {
+            fprintf(f, "%s%.9g", i ? ", " : "", arrays[a][i]);
+        }
+        fprintf(f, "]%s\n", a ? "" : ",");
+    }
+    fprintf(f, "}\n");
+    return fclose(f);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Extracts a number array from a baseline written by
+                benchWrite
+ * In arg:      text      Whole file contents
+                key       Name of the array
+ * Out arg:     n         Number of values
+ * Return val:  Malloc'd values, NULL if key is missing or no memory
+                is left
+ */
+double *jsonArray(const char *text, const char *key, int *n) {
+    char pat[64];
+    snprintf(pat, sizeof(pat), "\"%s\"", key);
+    const char *p = strstr(text, pat);
+    if (NULL == p || NULL == (p = strchr(p, '['))) return NULL;
+    int cap = 256;
+    double *v = malloc(cap * sizeof(double));
+    if (NULL == v) return NULL;
+    *n = 0;
+    for (p++; ; ) {
+        while (' ' == *p || ',' == *p || '\n' == *p) p++;
+        if (']' == *p || '\0' == *p) break;
+        char *end;
+        double d = strtod(p, &end);
+        if (end == p) break;
+        if (*n == cap) {
+            double *more = realloc(v, (cap *= 2) * sizeof(double));
+            if (NULL == more) {
+                free(v);
+                return NULL;
+            }
+            v = more;
+        }
+        v[(*n)++] = d;
+        p = end;
+    }
+    return v;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Loads the sample of a baseline file
+ * In arg:      path      Baseline written by benchWrite
+ * Out arg:     lat, wall Sample arrays (malloc'd)
+ * Return val:  Number of solves, -1 if the file is unusable
+ */
+int benchRead(const char *path, double **lat, double **wall) {
+    FILE *f = fopen(path, "r");
+    if (NULL == f) {
+        perror(path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+    char *text = size < 0 ? NULL : malloc(size + 1);
+    if (NULL == text) {
+        perror(path);
+        fclose(f);
+        return -1;
+    }
+    text[fread(text, 1, size, f)] = '\0';
+    fclose(f);
+
+    int n = -1, nw = 0, version = 0;
+    const char *v = strstr(text, "\"version\"");
+    if (v) sscanf(strchr(v, ':') + 1, "%d", &version);
+    if (BASELINE_VERSION != version) {
+        fprintf(stderr, "%s: baseline version %d, expected %d\n", path,
+                version, BASELINE_VERSION);
+    } else {
+        *lat = jsonArray(text, "latency", &n);
+        *wall = jsonArray(text, "wall", &nw);
+        if (NULL == *lat || NULL == *wall || n != nw || n < 1) {
+            fprintf(stderr, "%s: malformed baseline\n", path);
+            free(*lat);
+            free(*wall);
+            n = -1;
+        }
+    }
+    free(text);
+    return n;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Times passes over a corpus at every propagation level and
+                keeps the fastest in g_prop_level. Higher tiers cost more
+                per node and leave fewer nodes, so only the total time
+                of the corpus can tell which level pays. Levels take
+                turns, one pass each per round with the order rotated,
+                and every pass starts without the boards and results
+                that earlier passes left in g_dead and the cache
+ * In arg:      corpus    Puzzle file, see readBatch
+                reps      Rounds, at least PROP_SWEEP_ROUNDS
+                threads   Workers per solve
+ * Return val:  The level kept, -1 if the corpus could not be read or
+                nothing would call lockstepPropagate
+ */
+int propSweep(const char *corpus, int reps, int threads) {
+    bool simd = g_lockstep;
+    for (int i = 0; i < g_portfolio.len; i++) {
+        simd |= STRAT_SIMD == g_portfolio.list[i];
+    }
+    if (!simd || g_store.head) {
+        fprintf(stderr, "-e best needs -V or simd in -p, and no -s: "
+                "%s\n", g_store.head ? "the store answers repeats"
+                : "no search would use the propagation level");
+        return -1;
+    }
+    int count;
+    grid *jobs = readBatch(corpus, &count);
+    if (NULL == jobs || 0 == count) return -1;
+
+    int rounds = reps > PROP_SWEEP_ROUNDS ? reps : PROP_SWEEP_ROUNDS;
+    double total[PROP_LEVELS] = { 0 };
+    uint64_t nodes[PROP_LEVELS] = { 0 };
+    for (int level = 0; level < PROP_LEVELS; level++) {
+        g_prop_level = level;
+        solveNext(jobs, count, threads, NULL, NULL);
+    }
+    for (int r = 0; r < rounds; r++) {
+        for (int k = 0; k < PROP_LEVELS; k++) {
+            g_prop_level = (r + k) % PROP_LEVELS;
+            if (g_dead.buckets) {
+                memset(g_dead.slot, 0, g_dead.buckets * DEAD_BUCKET
+                                       * sizeof(uint64_t));
+            }
+            for (int i = 0; g_cache_slots && i < CACHE_SHARDS; i++) {
+                memset(g_cache[i].slot, 0, g_cache_slots
+                                           * sizeof(cache_entry));
+            }
+            uint64_t n0 = nodesTotal(), t0 = nowNs();
+            for (int j = 0; j < count; ) {
+                j += solveNext(&jobs[j], count - j, threads, NULL, NULL);
+            }
+            total[g_prop_level] += (nowNs() - t0) / 1e9;
+            nodes[g_prop_level] += nodesTotal() - n0;
+        }
+    }
+
+    int keep = 0;
+    for (int level = 0; level < PROP_LEVELS; level++) {
+        printf("level %d (%s): %.3f s for %d solves, %llu nodes\n", level,
+               g_prop_names[level], total[level], count * rounds,
+               (unsigned long long)nodes[level]);
+        if (total[level] < total[keep]) keep = level;
+    }
+    g_prop_level = keep;
+    printf("fastest propagation level: %d (%s)\n", keep, g_prop_names[keep]);
+    free(jobs);
+    return keep;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Benchmarks a corpus and optionally saves the sample as a
+                baseline and/or gates it against an earlier baseline
+ * In arg:      corpus    Puzzle file, see readBatch
+                reps      Passes over the corpus
+                threads   Workers per solve
+                out       Baseline to write, NULL to skip
+                base      Baseline to compare against, NULL to skip
+                threshold Relative change tolerated, e.g. 0.05
+ * Return val:  Process exit code; 2 if a regression was detected
+ */
+int runBenchmark(const char *corpus, int reps, int threads, const char *out,
+                 const char *base, double threshold) {
+    int count;
+    grid *jobs = readBatch(corpus, &count);
+    if (NULL == jobs || 0 == count) return 1;
+
+    int n = count * reps;
+    double *lat = malloc(n * sizeof(double));
+    double *wall = malloc(n * sizeof(double));
+    double *sorted = malloc(n * sizeof(double));
+    if (NULL == lat || NULL == wall || NULL == sorted) {
+        perror("-B");
+        free(lat);
+        free(wall);
+        free(sorted);
+        free(jobs);
+        return 1;
+    }
+
+    // An unmeasured pass faults in stacks and code and grows the arenas to
+    // the largest job of the corpus; one more solve past the serial fast
+    // path starts the workers even when every puzzle stays serial
+    for (int j = 0; j < count; ) {
+        j += solveNext(&jobs[j], count - j, threads, NULL, NULL);
+    }
+    uint64_t budget = g_adapt.budget;
+    g_adapt.budget = budget ? 1 : 0;
+    solveNext(jobs, count, threads, NULL, NULL);
+    g_adapt.budget = budget;
+    uint64_t allocs = __atomic_load_n(&g_heap_allocs, __ATOMIC_RELAXED);
+    for (int r = 0, k = 0; r < reps; r++) {
+        for (int j = 0, used; j < count; j += used, k += used) {
+            statSet(&g_queue_depth, n - k - 1);
+            used = solveNext(&jobs[j], count - j, threads, &lat[k], &wall[k]);
+        }
+    }
+
+    // Read before printing: the first printf allocates the stdout buffer
+    allocs = __atomic_load_n(&g_heap_allocs, __ATOMIC_RELAXED) - allocs;
+    double cur[BS_COUNT];
+    benchStats(lat, wall, n, sorted, cur);
+    printf("corpus %s: %d puzzles x %d passes, %d threads\n", corpus, count,
+           reps, threads);
+    printf("throughput %.1f solves/s, p50 %.6f s, p90 %.6f s, p99 %.6f s\n",
+           cur[BS_THROUGHPUT], cur[BS_P50], cur[BS_P90], cur[BS_P99]);
+#if defined(__GLIBC__) && defined(SUD_HEAP_COUNT)
+    printf("heap allocations after warm-up: %llu\n",
+           (unsigned long long)allocs);
+#else
+    (void)allocs;
+    printf("heap allocations after warm-up: not counted\n");
+#endif
+    if (g_dead.buckets) {
+        uint64_t probes = metricsCount(offsetof(worker_metrics, dead_probes));
+        uint64_t hits = metricsCount(offsetof(worker_metrics, dead_hits));
+        printf("dead boards: %llu lookups, %.2f%% hits, %llu stored\n",
+               (unsigned long long)probes, probes ? 100.0 * hits / probes : 0,
+               (unsigned long long)metricsCount(offsetof(worker_metrics,
+                                                         dead_stores)));
+    }
+    if (g_cache_slots) {
+        printf("cache: %llu hits, %llu misses\n",
+               (unsigned long long)cacheCount(offsetof(cache_shard, hits)),
+               (unsigned long long)cacheCount(offsetof(cache_shard, misses)));
+    }
+    if (g_adapt.budget) {
+        uint64_t serial = statGet(&g_adapt.serial);
+        uint64_t parallel = statGet(&g_adapt.parallel);
+        printf("adaptive: %llu serial, %llu escalated to %d subtrees per "
+               "worker after %llu nodes; %.6f s per serial attempt\n",
+               (unsigned long long)serial, (unsigned long long)parallel,
+               g_adapt.split, (unsigned long long)g_adapt.budget,
+               serial + parallel ? statGet(&g_adapt.serial_ns) / 1e9
+                                   / (serial + parallel) : 0);
+    }
+    if (g_route.on && g_route.n) {
+        double n = g_route.n;
+        double vx = g_route.sxx - g_route.sx * g_route.sx / n;
+        double vy = g_route.syy - g_route.sy * g_route.sy / n;
+        double cov = g_route.sxy - g_route.sx * g_route.sy / n;
+        printf("model: %llu predictions, mean error %.3f log10 nodes, r %.3f,"
+               " serial or escalated called right %.1f%%, %.1f workers per "
+               "escalation\n", (unsigned long long)g_route.n,
+               g_route.err / n, vx > 0 && vy > 0 ? cov / powTen(logTen(vx * vy) / 2) : 0,
+               100.0 * g_route.right / n, g_route.escalations
+               ? (double)g_route.workers / g_route.escalations : 0);
+    }
+    if (g_portfolio.len) {
+        printf("portfolio wins:");
+        for (int k = 0; k < STRAT_COUNT; k++) {
+            if (0 == g_portfolio.races[k]) continue;
+            printf(" %s %llu/%llu (%.1f%%)", g_strat_names[k],
+                   (unsigned long long)g_portfolio.wins[k],
+                   (unsigned long long)g_portfolio.races[k],
+                   100.0 * g_portfolio.wins[k] / g_portfolio.races[k]);
+        }
+        printf(", %llu restarts\n", (unsigned long long)
+               metricsCount(offsetof(worker_metrics, restarts)));
+    }
+    if (g_store.head) {
+        printf("store: %llu hits, %llu misses, %llu of %llu records used\n",
+               (unsigned long long)statGet(&g_store.hits),
+               (unsigned long long)statGet(&g_store.misses),
+               (unsigned long long)statGet(&g_store.head->count),
+               (unsigned long long)g_store.head->slots);
+    }
+
+    int rc = 0;
+    if (out && 0 != benchWrite(out, corpus, threads, lat, wall, n, sorted)) {
+        rc = 1;
+    }
+    double *b_lat, *b_wall;
+    int nb = base ? benchRead(base, &b_lat, &b_wall) : 0;
+    if (nb < 0) rc = 1;
+    if (nb > 0) {
+        double *more = nb > n ? realloc(sorted, nb * sizeof(double)) : sorted;
+        if (more) sorted = more;
+        double old[BS_COUNT], lo[BS_COUNT], hi[BS_COUNT];
+        if (NULL == more
+            || 0 != bootstrapRatio(b_lat, b_wall, nb, lat, wall, n, lo, hi)) {
+            perror(base);
+            rc = 1;
+        } else {
+            benchStats(b_lat, b_wall, nb, sorted, old);
+            printf("%-10s %12s %12s %8s %19s  %s\n", "metric", "baseline",
+                   "current", "ratio", "95% CI", "verdict");
+            for (int m = 0; m < BS_COUNT; m++) {
+                // Throughput regresses downwards, latencies upwards
+                bool worse = BS_THROUGHPUT == m ? hi[m] < 1 - threshold
+                                                : lo[m] > 1 + threshold;
+                bool better = BS_THROUGHPUT == m ? lo[m] > 1 + threshold
+                                                 : hi[m] < 1 - threshold;
+                printf("%-10s %12.6g %12.6g %8.3f   [%6.3f, %6.3f]  %s\n",
+                       g_bench_names[m], old[m], cur[m],
+                       old[m] > 0 ? cur[m] / old[m] : 1, lo[m], hi[m],
+                       worse ? "REGRESSION" : better ? "improved" : "ok");
+                if (worse) rc = 2;
+            }
+        }
+        free(b_lat);
+        free(b_wall);
+    }
+#if defined(__GLIBC__) && defined(SUD_HEAP_COUNT)
+    // Steady-state solving is meant to stay off the heap
+    if (allocs) {
+        fprintf(stderr, "-B: %llu heap allocations after warm-up, "
+                "expected 0\n", (unsigned long long)allocs);
+        if (0 == rc) rc = 3;
+    }
+#endif
+    free(lat);
+    free(wall);
+    free(sorted);
+    free(jobs);
+    return rc;
+}
+
+
+
+/*-------------------------------------------------------------------
+ * Purpose:     Returns the reply for a puzzle, solving it only if no
+                other connection has the same puzzle queued or running
+ * In arg:      puzzle    Parsed puzzle
+ * Out arg:     reply     Result line, as sent to the result server;
+                          invalid if no memory is left for the puzzle
+ */
+void flightJoin(const uint8_t *puzzle, char *reply) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (int c = 0; c < g_geo.cells; c++) h = (h ^ puzzle[c]) * 0x100000001b3ull;
+
+    // Allocated before locking, so that no connection waits on the heap
+    flight *fresh = calloc(1, sizeof(flight));
+    if (NULL == fresh) {
+        perror("calloc");
+        snprintf(reply, sizeof(buff), "%s 0.000000 \n",
+                 g_status_names[ST_INVALID]);
+        return;
+    }
+
+    pthread_mutex_lock(&g_flights.lock);
+    g_flights.requests++;
+    flight **b = &g_flights.bucket[h % FLIGHT_BUCKETS], *f = *b;
+    while (f && (f->hash != h || 0 != memcmp(f->puzzle, puzzle, g_geo.cells))) {
+        f = f->chain;
+    }
+    if (f) {
+        g_flights.coalesced++;
+    } else {
+        f = fresh;
+        fresh = NULL;
+        memcpy(f->puzzle, puzzle, g_geo.cells);
+        f->hash = h;
+        f->chain = *b;
+        *b = f;
+        if (g_flights.tail) g_flights.tail->next = f;
+        else g_flights.head = f;
+        g_flights.tail = f;
+        statSet(&g_queue_depth, ++g_flights.depth);
+        pthread_cond_signal(&g_flights.queued);
+    }
+    f->waiters++;
+    while (!f->done) pthread_cond_wait(&g_flights.served, &g_flights.lock);
+    memcpy(reply, f->reply, sizeof(f->reply));
+    if (0 == --f->waiters) free(f);
+    pthread_mutex_unlock(&g_flights.lock);
+    free(fresh);
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Serves one client: reads puzzles, one per line in the
+                format of -f, and writes a result line for each. A line
+                of SERVE_LINE bytes or more is skipped and answered as
+                invalid
+ * In arg:      arg       Connected socket, cast to a pointer
+ */
+void *serveClient(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    FILE *in = fdopen(fd, "r");
+    char line[SERVE_LINE], reply[sizeof(buff)];
+    while (in && fgets(line, sizeof(line), in)) {
+        grid g;
+        bool whole = strchr(line, '\n') || feof(in);
+        if (!whole) {
+            // Too long for any puzzle: skip to the end of the line
+            int ch;
+            while (EOF != (ch = getc(in)) && '\n' != ch);
+        } else if ('\n' == line[0] || '#' == line[0]) {
+            continue;
+        }
+        if (whole && parsePuzzle(line, g)) {
+            flightJoin(g, reply);
+        } else {
+            snprintf(reply, sizeof(reply), "%s 0.000000 \n",
+                     g_status_names[ST_INVALID]);
+        }
+        if (send(fd, reply, strlen(reply), MSG_NOSIGNAL) < 0) break;
+    }
+    if (in) fclose(in);
+    else close(fd);
+    pthread_mutex_lock(&g_flights.lock);
+    g_flights.clients--;
+    pthread_cond_signal(&g_flights.left);
+    pthread_mutex_unlock(&g_flights.lock);
+    return NULL;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Accepts clients, one thread each. At SERVE_CLIENTS
+                connections it stops accepting until one closes, so
+                later clients wait in the listen backlog
+ * In arg:      arg       Listening socket, cast to a pointer
+ */
+void *serveAccept(void *arg) {
+    int lfd = (int)(intptr_t)arg;
+    for (;;) {
+        pthread_mutex_lock(&g_flights.lock);
+        while (g_flights.clients >= SERVE_CLIENTS) {
+            pthread_cond_wait(&g_flights.left, &g_flights.lock);
+        }
+        g_flights.clients++;
+        pthread_mutex_unlock(&g_flights.lock);
+
+        int fd = accept(lfd, NULL, NULL);
+        pthread_t t;
+        if (fd < 0 || 0 != pthread_create(&t, NULL, serveClient,
+                                          (void *)(intptr_t)fd)) {
+            if (fd < 0 && EINTR != errno && ECONNABORTED != errno) {
+                perror("accept");
+                exit(1);
+            }
+            if (fd >= 0) close(fd);
+            pthread_mutex_lock(&g_flights.lock);
+            g_flights.clients--;
+            pthread_mutex_unlock(&g_flights.lock);
+            continue;
+        }
+        pthread_detach(t);
+    }
+    return NULL;
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Runs the server: the calling thread solves queued
+                flights one at a time with thread_num workers, as main
+                does for argv puzzles, while clients are served from
+                their own threads. Logs the coalescing counts to stderr
+                whenever the queue runs dry
+ * In arg:      host          IPv4 address to listen on; NULL for
+                              127.0.0.1, as clients are not authenticated
+                port          TCP port to listen on
+                thread_num    Workers per solve
+ * Return val:  Process exit code; only returns if listening fails
+ */
+int serve(const char *host, int port, int thread_num) {
+    int lfd = socket(AF_INET, SOCK_STREAM, 0), one = 1;
+    struct sockaddr_in addr = { .sin_family = AF_INET,
+                                .sin_port = htons(port),
+                                .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    if (host && 1 != inet_pton(AF_INET, host, &addr.sin_addr)) {
+        fprintf(stderr, "%s: not an IPv4 address\n", host);
+        return 1;
+    }
+    if (lfd < 0
+        || 0 != setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one))
+        || 0 != bind(lfd, (struct sockaddr *)&addr, sizeof(addr))
+        || 0 != listen(lfd, SOMAXCONN)) {
+        perror("listen");
+        return 1;
+    }
+    pthread_t t;
+    pthread_create(&t, NULL, serveAccept, (void *)(intptr_t)lfd);
+
+    for (;;) {
+        pthread_mutex_lock(&g_flights.lock);
+        if (NULL == g_flights.head && g_flights.solves) {
+            fprintf(stderr, "served %llu requests with %llu solves; %llu "
+                    "coalesced, saving %.3f of %.3f CPU s\n",
+                    (unsigned long long)g_flights.requests,
+                    (unsigned long long)g_flights.solves,
+                    (unsigned long long)g_flights.coalesced,
+                    g_flights.cpu_saved, g_flights.cpu + g_flights.cpu_saved);
+        }
+        while (NULL == g_flights.head) {
+            pthread_cond_wait(&g_flights.queued, &g_flights.lock);
+        }
+        flight *f = g_flights.head;
+        g_flights.head = f->next;
+        if (NULL == g_flights.head) g_flights.tail = NULL;
+        statSet(&g_queue_depth, --g_flights.depth);
+        pthread_mutex_unlock(&g_flights.lock);
+
+        struct timespec c0, c1;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &c0);
+        int status = solvePuzzle(f->puzzle, f->puzzle, thread_num);
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &c1);
+        double cpu = (c1.tv_sec - c0.tv_sec) + (c1.tv_nsec - c0.tv_nsec) / 1e9;
+        char *b1 = ST_SOLVED == status ? buffSudoku(&g_solution, g_elapsed)
+                                       : buffStatus(status, g_elapsed);
+
+        // Later arrivals start a new flight; the waiters share this one
+        pthread_mutex_lock(&g_flights.lock);
+        flight **b = &g_flights.bucket[f->hash % FLIGHT_BUCKETS];
+        while (*b != f) b = &(*b)->chain;
+        *b = f->chain;
+        memcpy(f->reply, b1, sizeof(f->reply));
+        f->done = 1;
+        g_flights.solves++;
+        g_flights.cpu += cpu;
+        g_flights.cpu_saved += cpu * (f->waiters - 1);
+        pthread_cond_broadcast(&g_flights.served);
+        pthread_mutex_unlock(&g_flights.lock);
+        if (g_metrics_path) metricsWrite(g_metrics_path, thread_num);
+    }
+}
+
+/*-------------------------------------------------------------------
+ * Purpose:     Prints command line help to stderr
+ * In arg:      prog      Name the program was invoked with
+ */
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-n box] [-T trace.json] [-L] [-P] [-M metrics.prom] "
+            "[-H entries] [-Z entries] [-s store] [-p list] "
+            "[-A nodes[:split]] [-j] [-e level] [-C cap | -u] "
+            "<n*n cells> [threads]\n"
+            "       %s [options] -E solutions.bin [-K checkpoint] "
+            "<n*n cells> [threads]\n"
+            "       %s [options] -G count [-g clues] [-S sym] [-D lo:hi] "
+            "[threads]\n"
+            "       %s [options] [-V | -R] -f puzzles.txt [threads]\n"
+            "       %s [options] -B corpus.txt [-r passes] [-w new.json] "
+            "[-c baseline.json] [-x percent] [threads]\n"
+            "       %s [options] -l [addr:]port [threads]\n", prog, prog, prog, prog,
+            prog, prog);
+}
+
+
+
+int main(int argc, char** argv) {
+
+    int thread_num;
+    g_hot.finished = 0;
+    grid puzzle = { 0 }; // Array to store problem
+    int opt;
+
+    bool lock_profile = 0;
+    const char *batch_path = NULL;
+    const char *bench_path = NULL;  // corpus to benchmark
+    const char *baseline_out = NULL;
+    const char *baseline_in = NULL;
+    int reps = 5;
+    double threshold = 0.05;
+    int rc = 0;
+    bool perf = 0;
+    int box = 3;
+    const char *enum_path = NULL;  // enumeration output
+    bool rate = 0;
+    size_t cache_entries = 0;  // result cache size, 0 for none
+    size_t dead_entries = 0;   // refuted board table size, 0 for none
+    const char *store_path = NULL;  // solution store file
+    int listen_port = 0;  // server mode port, 0 for none
+    char *listen_host = NULL;  // address to serve on, NULL for loopback
+    bool prop_sweep = 0;  // -B picks the propagation level first
+
+    while (-1 != (opt = getopt(argc, argv, "T:LM:f:B:r:w:c:x:Pn:VC:uE:K:G:g:S:D:RH:s:l:p:A:jZ:e:"))) {
+        switch (opt) {
+        case 'T':
+            g_trace_path = optarg;
+            break;
+        case 'L':
+            lock_profile = 1;
+            break;
+        case 'M':
+            g_metrics_path = optarg;
+            break;
+        case 'f':
+            batch_path = optarg;
+            break;
+        case 'B':
+            bench_path = optarg;
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'w':
+            baseline_out = optarg;
+            break;
+        case 'c':
+            baseline_in = optarg;
+            break;
+        case 'x':
+            threshold = atof(optarg) / 100;
+            break;
+        case 'P':
+            perf = 1;
+            break;
+        case 'V':
+            g_lockstep = 1;
+            break;
+        case 'j':
+            g_backjump = 0;
+            break;
+        case 'e': {
+            int level = 0;
+            while (level < PROP_LEVELS
+                   && 0 != strcmp(optarg, g_prop_names[level])
+                   && (optarg[0] != '0' + level || optarg[1])) {
+                level++;
+            }
+            prop_sweep = 0 == strcmp(optarg, "best");
+            if (level < PROP_LEVELS) g_prop_level = level;
+            else if (!prop_sweep) {
+                fprintf(stderr, "propagation level must be 0 to %d, one of "
+                        "singles, locked, subsets or fish, or best\n",
+                        PROP_LEVELS - 1);
+                return 1;
+            }
+            break;
+        }
+        case 'C':
+            g_count_cap = strtoull(optarg, NULL, 10);
+            if (g_count_cap < 2) {
+                fprintf(stderr, "count cap must be at least 2\n");
+                return 1;
+            }
+            break;
+        case 'u':
+            g_count_cap = 2;
+            break;
+        case 'E':
+            enum_path = optarg;
+            break;
+        case 'K':
+            g_enum.checkpoint = optarg;
+            break;
+        case 'G':
+            g_gen.count = atoi(optarg);
+            break;
+        case 'g':
+            g_gen.clues = atoi(optarg);
+            break;
+        case 'S':
+            g_gen.sym = 0;
+            while (g_gen.sym < SYM_COUNT
+                   && 0 != strcmp(optarg, g_sym_names[g_gen.sym])) {
+                g_gen.sym++;
+            }
+            if (SYM_COUNT == g_gen.sym) {
+                fprintf(stderr, "symmetry must be none, mirror, 180 or 90\n");
+                return 1;
+            }
+            break;
+        case 'D':
+            if (2 != sscanf(optarg, "%lf:%lf", &g_gen.dmin, &g_gen.dmax)
+                || g_gen.dmin > g_gen.dmax) {
+                fprintf(stderr, "difficulty band must be lo:hi\n");
+                return 1;
+            }
+            g_gen.rated = 1;
+            break;
+        case 'R':
+            rate = 1;
+            break;
+        case 'H':
+            cache_entries = strtoull(optarg, NULL, 10);
+            break;
+        case 'Z':
+            dead_entries = strtoull(optarg, NULL, 10);
+            break;
+        case 's':
+            store_path = optarg;
+            break;
+        case 'A':
+            g_adapt.budget = strtoull(optarg, NULL, 10);
+            if (strchr(optarg, ':')) {
+                g_adapt.split = atoi(strchr(optarg, ':') + 1);
+            }
+            if (g_adapt.split < 1) {
+                fprintf(stderr, "subproblems per worker must be positive\n");
+                return 1;
+            }
+            break;
+        case 'p':
+            if (!portfolioParse(optarg)) {
+                fprintf(stderr, "portfolio must list scan, mrv, mrv-rev, "
+                        "restart, scan-restart, dlx, simd or sat, or be "
+                        "all\n");
+                return 1;
+            }
+            break;
+        case 'l':
+            if (strchr(optarg, ':')) {
+                listen_host = optarg;
+                *strrchr(optarg, ':') = '\0';
+                optarg += strlen(optarg) + 1;
+            }
+            listen_port = atoi(optarg);
+            if (listen_port < 1 || listen_port > 65535) {
+                fprintf(stderr, "port must be 1 to 65535\n");
+                return 1;
+            }
+            g_batch = 1;
+            break;
+        case 'n':
+            box = atoi(optarg);
+            if (box < 2 || box > MAXBOX) {
+                fprintf(stderr, "box size must be 2 to %d\n", MAXBOX);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    geometryInit(&g_geo, box);
+    if (prop_sweep && !bench_path) {
+        fprintf(stderr, "-e best needs -B\n");
+        return 1;
+    }
+    if (argc - optind < (batch_path || bench_path || g_gen.count
+                         || listen_port ? 0 : g_geo.cells)
+        || reps < 1 || (enum_path && (batch_path || bench_path))) {
+        usage(argv[0]);
+        return 1;
+    }
+
+
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&is_fin, NULL);
+    pthread_rwlockattr_init (&mylock_attr);
+    // Preferring writer-locks for rwlocks
+    pthread_rwlockattr_setkind_np(&mylock_attr,
+          PTHREAD_RWLOCK_PREFER_WRITER_NP);
+    pthread_rwlock_init(&g_hot.lock , &mylock_attr);
+    pthread_attr_init(&g_worker_attr);
+    pthread_attr_setstacksize(&g_worker_attr, WORKER_STACK);
+
+
+    // Converting problem from **argv to 2d integer array
+    int c3 = optind;
+    grid *jobs = &puzzle;
+    int job_count = 1;
+    if (bench_path || g_gen.count || listen_port) {
+        job_count = 0;
+    } else if (batch_path) {
+        jobs = readBatch(batch_path, &job_count);
+        if (NULL == jobs) return 1;
+        g_batch = 1;
+    } else {
+        for (int c = 0; c < g_geo.cells; c++, c3++) {
+            int v = atoi(argv[c3]);
+            puzzle[c] = v < 0 || v > MAXN ? MAXN + 1 : v;
+        }
+    }
+
+    // Getting number of threads to use; without one the model sizes each
+    // solve from a pool of one worker per CPU
+    if (c3 >= argc || 0 == strcmp(argv[c3], "auto")) {
+        thread_num = sysconf(_SC_NPROCESSORS_ONLN);
+        g_route.on = 1;
+    } else {
+        thread_num = atoi(argv[c3]);
+    }
+    if (thread_num < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Initializing socket for client side; benchmarks send nothing
+    struct sockaddr_in serv_addr;
+
+    if (!bench_path && !g_gen.count && !rate && !listen_port) {
+        sockfd = socket(AF_INET, SOCK_STREAM, 0);
+        memset(&serv_addr, '0', sizeof(serv_addr));
+        serv_addr.sin_family = AF_INET;
+        serv_addr.sin_port = htons(PORT);
+        inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr);
+        connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr));
+    }
+
+
+
+    t_rng = (nowNs() ^ 0x9E3779B97F4A7C15ull) | 1;
+    t_limit = UINT64_MAX;
+
+    // Rings are allocated up front so recording never touches the heap
+    if (g_trace_path) {
+        g_rings = (trace_ring *) calloc(thread_num + 1, sizeof(trace_ring));
+        t_ring = &g_rings[0];
+        g_trace_epoch = nowNs();
+    }
+    if (lock_profile) {
+        g_lstats = (lock_stats *) aligned_alloc(64,
+                (thread_num + 1) * LK_COUNT * sizeof(lock_stats));
+        memset(g_lstats, 0, (thread_num + 1) * LK_COUNT * sizeof(lock_stats));
+        t_lstats = &g_lstats[0];
+    }
+    g_metrics = (worker_metrics *) aligned_alloc(64,
+            (thread_num + 1) * sizeof(worker_metrics));
+    memset(g_metrics, 0, (thread_num + 1) * sizeof(worker_metrics));
+    g_metric_slots = thread_num + 1;
+    g_metrics_epoch = nowNs();
+    t_metrics = &g_metrics[0];
+    g_arenas = (arena *) calloc(thread_num + 1, sizeof(arena));
+    t_arena = &g_arenas[0];
+
+    if (cache_entries && 0 != cacheInit(cache_entries)) return 1;
+    if (dead_entries && 0 != deadInit(dead_entries)) return 1;
+    if (store_path && 0 != storeOpen(store_path)) return 1;
+    if (perf) perfStart();
+    if (bench_path) {
+        rc = prop_sweep && propSweep(bench_path, reps, thread_num) < 0 ? 1
+           : runBenchmark(bench_path, reps, thread_num, baseline_out,
+                          baseline_in, threshold);
+    }
+    if (enum_path) {
+        rc = enumPuzzle(puzzle, thread_num, enum_path);
+        job_count = 0;
+    }
+    if (g_gen.count) {
+        rc = generatePuzzles(thread_num);
+    }
+    if (rate) {
+        rc = ratePuzzles(jobs, job_count, thread_num);
+        job_count = 0;
+    }
+    if (listen_port) {
+        rc = serve(listen_host, listen_port, thread_num);
+    }
+    for (int j = 0; j < job_count; ) {
+        statSet(&g_queue_depth, job_count - j - 1);
+        j += solveNext(&jobs[j], job_count - j, thread_num, NULL, NULL);
+        if (g_metrics_path && batch_path) {
+            metricsWrite(g_metrics_path, thread_num);
+        }
+    }
+
+    if (g_trace_path) {
+        traceWrite(g_trace_path, thread_num + 1);
+    }
+    if (g_lstats) {
+        lockReport(thread_num + 1);
+    }
+    if (perf) {
+        perfReport(g_solve_seq);
+    }
+    if (g_metrics_path) {
+        metricsWrite(g_metrics_path, thread_num);
+    }
+
+    pthread_mutex_destroy(&mutex);
+    pthread_rwlock_destroy(&g_hot.lock);
+    pthread_cond_destroy(&is_fin);
+    return rc;
     // Main function finishes execution and all other threads terminated
 }
-# sudoku_pthread